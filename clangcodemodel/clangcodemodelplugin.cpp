@@ -30,6 +30,9 @@
 #include "clangcodemodelplugin.h"
 #include "clangprojectsettingspropertiespage.h"
 #include "fastindexer.h"
+#ifdef CLANG_INDEXING
+#  include "indexermetricswidget.h"
+#endif // CLANG_INDEXING
 #include "pchmanager.h"
 #include "utils.h"
 
@@ -44,11 +47,14 @@
 #include <projectexplorer/projectexplorer.h>
 #include <projectexplorer/session.h>
 
+#include <QSettings>
 #include <QtPlugin>
 
 namespace ClangCodeModel {
 namespace Internal {
 
+static const char kUnitsMemoryBudgetKey[] = "ClangCodeModel/UnitsMemoryBudgetMB";
+
 bool ClangCodeModelPlugin::initialize(const QStringList &arguments, QString *errorMessage)
 {
     Q_UNUSED(arguments)
@@ -58,6 +64,11 @@ bool ClangCodeModelPlugin::initialize(const QStringList &arguments, QString *err
 
     ClangCodeModel::Internal::initializeClang();
 
+    const qint64 budgetMB = Core::ICore::settings()->value(
+                QLatin1String(kUnitsMemoryBudgetKey),
+                int(SharedUnits::DefaultMemoryBudgetMB)).toLongLong();
+    m_sharedUnits.setMemoryBudget(budgetMB * 1024 * 1024);
+
     connect(Core::EditorManager::instance(), SIGNAL(editorAboutToClose(Core::IEditor*)),
             &m_liveUnitsManager, SLOT(editorAboutToClose(Core::IEditor*)));
     connect(Core::EditorManager::instance(), SIGNAL(editorOpened(Core::IEditor*)),
@@ -70,6 +81,7 @@ bool ClangCodeModelPlugin::initialize(const QStringList &arguments, QString *err
     m_indexer.reset(new ClangIndexer);
     fastIndexer = m_indexer.data();
     CppTools::CppModelManagerInterface::instance()->setIndexingSupport(m_indexer->indexingSupport());
+    addAutoReleasedObject(new IndexerMetricsNavigationWidgetFactory(m_indexer->metrics()));
 #endif // CLANG_INDEXING
 
     // wire up the pch manager
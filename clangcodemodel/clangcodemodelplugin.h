@@ -32,6 +32,8 @@
 
 #include "clangmodelmanagersupport.h"
 #include "liveunitsmanager.h"
+#include "sharedunits.h"
+#include "unsavedfilesstore.h"
 
 #ifdef CLANG_INDEXING
 #  include "clangindexer.h"
@@ -54,6 +56,8 @@ public:
 
 private:
     LiveUnitsManager m_liveUnitsManager;
+    UnsavedFilesStore m_unsavedFilesStore;
+    SharedUnits m_sharedUnits;
     QScopedPointer<ModelManagerSupport> m_modelManagerSupport;
 #ifdef CLANG_INDEXING
     QScopedPointer<ClangIndexer> m_indexer;
@@ -67,6 +71,16 @@ private slots:
     void test_CXX_snippets_data();
     void test_ObjC_hints();
     void test_ObjC_hints_data();
+    void test_globalCompletionCache();
+    void test_indexedMembers();
+    void test_classHierarchy();
+    void test_warmUp();
+    void test_unitsMemoryBudget();
+    void test_completionService();
+    void test_CXX_completionBenchmark();
+    void test_CXX_completionBenchmark_data();
+    void test_CXX_memoryGrowth();
+    void test_CXX_memoryGrowth_data();
 #endif
 };
 
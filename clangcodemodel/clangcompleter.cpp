@@ -32,25 +32,41 @@
 #include "unsavedfiledata.h"
 #include "utils_p.h"
 #include "completionproposalsbuilder.h"
+#include "globalcompletioncache.h"
 #include "raii/scopedclangoptions.h"
+#include "sharedunits.h"
 #include "unit.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QSet>
 #include <QTime>
+#include <QWaitCondition>
 
 #include <clang-c/Index.h>
 
 //#define TIME_COMPLETION
 
+// Completions faster than this are not worth delaying, in ms.
+static const int MIN_COALESCED_LATENCY = 50;
+// Upper bound of the coalescing window, so slow files still feel responsive, in ms.
+static const int MAX_COALESCING_WINDOW = 100;
+
 class ClangCodeModel::ClangCompleter::PrivateData
 {
 public:
     PrivateData()
         : m_mutex(QMutex::Recursive)
         , m_isSignalSlotCompletion(false)
+        , m_globalCache(0)
+        , m_lastRequest(0)
+        , m_firstCurrentRequest(0)
+        , m_lastRevision(-1)
+        , m_lastPosition(-1)
+        , m_averageLatency(0)
     {
     }
 
@@ -58,28 +74,44 @@ public:
     {
     }
 
+    // The unit is shared with highlighting, callers hold its mutex
     bool parseFromFile(const Internal::UnsavedFiles &unsavedFiles)
     {
         Q_ASSERT(!m_unit.isLoaded());
         if (m_unit.fileName().isEmpty())
             return false;
 
-        unsigned opts = clang_defaultEditingTranslationUnitOptions();
-#if defined(CINDEX_VERSION) && (CINDEX_VERSION > 5)
-        opts |= CXTranslationUnit_CacheCompletionResults;
-        opts |= CXTranslationUnit_IncludeBriefCommentsInCodeCompletion;
-#endif
-        m_unit.setManagementOptions(opts);
-
         m_unit.setUnsavedFiles(unsavedFiles);
         m_unit.parse();
+        SharedUnits::parsed(m_unit);
         return m_unit.isLoaded();
     }
 
+    QList<CodeCompletionResult> complete(unsigned line, unsigned column, bool skipPreamble,
+                                         CXCursorKind *containerKind = 0,
+                                         QString *containerUsr = 0);
+    bool completeWithGlobalCache(unsigned line, unsigned column,
+                                 const Internal::UnsavedFiles &unsavedFiles,
+                                 QList<CodeCompletionResult> *completions);
+    bool namespaceScope(unsigned line, unsigned column, QString *scopeUsr) const;
+
 public:
     QMutex m_mutex;
+    QString m_fileName;
     Internal::Unit m_unit;
+    QByteArray m_optionsFingerprint;
     bool m_isSignalSlotCompletion;
+    Internal::GlobalCompletionCache *m_globalCache;
+    QByteArray m_pchFingerprint;
+
+    // Not guarded by m_mutex, which is held during libclang calls
+    mutable QMutex m_requestMutex;
+    quint64 m_lastRequest;
+    quint64 m_firstCurrentRequest;
+    int m_lastRevision;
+    int m_lastPosition;
+    mutable QWaitCondition m_requestStarted;
+    int m_averageLatency; // Of recent completions, in ms.
 };
 
 using namespace ClangCodeModel;
@@ -91,6 +123,8 @@ using namespace ClangCodeModel::Internal;
 CodeCompletionResult::CodeCompletionResult()
     : m_priority(SHRT_MAX)
     , m_completionKind(Other)
+    , m_hintIndex(0)
+    , m_hintVariant(0)
     , m_availability(Available)
     , m_hasParameters(false)
 {}
@@ -103,11 +137,79 @@ CodeCompletionResult::CodeCompletionResult()
 CodeCompletionResult::CodeCompletionResult(unsigned priority)
     : m_priority(SHRT_MAX - priority)
     , m_completionKind(Other)
+    , m_hintIndex(0)
+    , m_hintVariant(0)
     , m_availability(Available)
     , m_hasParameters(false)
 {
 }
 
+QString CodeCompletionResult::hint() const
+{
+    if (m_hintSource)
+        return m_hintSource->hint(m_hintIndex, m_hintVariant);
+    return m_hint;
+}
+
+void CodeCompletionResult::setHintSource(const QSharedPointer<CompletionHintSource> &source,
+                                         unsigned index, int variant)
+{
+    m_hint.clear();
+    m_hintSource = source;
+    m_hintIndex = index;
+    m_hintVariant = variant;
+}
+
+/**
+ * @brief Orders results with lazily built hints by their position in the libclang
+ * result list, so sorting doesn't materialize any hint
+ */
+int CodeCompletionResult::compareHints(const CodeCompletionResult &other) const
+{
+    if (!m_hintSource && !other.m_hintSource) {
+        if (m_hint < other.m_hint)
+            return -1;
+        else if (m_hint > other.m_hint)
+            return 1;
+        return 0;
+    }
+
+    if (!m_hintSource || !other.m_hintSource)
+        return m_hintSource ? 1 : -1;
+    if (m_hintIndex != other.m_hintIndex)
+        return m_hintIndex < other.m_hintIndex ? -1 : 1;
+    if (m_hintVariant != other.m_hintVariant)
+        return m_hintVariant < other.m_hintVariant ? -1 : 1;
+    return 0;
+}
+
+QDataStream &ClangCodeModel::operator<<(QDataStream &stream, const CodeCompletionResult &ccr)
+{
+    stream << quint32(ccr.priority()) << qint32(ccr.completionKind())
+           << qint32(ccr.availability()) << ccr.text() << ccr.hint() << ccr.snippet()
+           << ccr.hasParameters();
+    return stream;
+}
+
+QDataStream &ClangCodeModel::operator>>(QDataStream &stream, CodeCompletionResult &ccr)
+{
+    quint32 priority;
+    qint32 kind, availability;
+    QString text, hint, snippet;
+    bool hasParameters;
+    stream >> priority >> kind >> availability >> text >> hint >> snippet >> hasParameters;
+
+    // The constructor reverses clang's priority, undo it.
+    ccr = CodeCompletionResult(SHRT_MAX - priority);
+    ccr.setCompletionKind(CodeCompletionResult::Kind(kind));
+    ccr.setAvailability(CodeCompletionResult::Availability(availability));
+    ccr.setText(text);
+    ccr.setHint(hint);
+    ccr.setSnippet(snippet);
+    ccr.setHasParameters(hasParameters);
+    return stream;
+}
+
 ClangCompleter::ClangCompleter()
     : d(new PrivateData)
 {
@@ -119,13 +221,15 @@ ClangCompleter::~ClangCompleter()
 
 QString ClangCompleter::fileName() const
 {
-    return d->m_unit.fileName();
+    return d->m_fileName;
 }
 
 void ClangCompleter::setFileName(const QString &fileName)
 {
-    if (d->m_unit.fileName() != fileName) {
-        d->m_unit = Internal::Unit(fileName);
+    if (d->m_fileName != fileName) {
+        d->m_fileName = fileName;
+        d->m_unit = Internal::Unit();
+        d->m_optionsFingerprint.clear();
     }
 }
 
@@ -136,9 +240,12 @@ QStringList ClangCompleter::options() const
 
 void ClangCompleter::setOptions(const QStringList &options) const
 {
-    if (d->m_unit.compilationOptions() != options) {
-        d->m_unit.setCompilationOptions(options);
-        d->m_unit.unload();
+    // The options are rebuilt for every request, only a different fingerprint means
+    // that the unit would really parse differently
+    const QByteArray fingerprint = Internal::optionsFingerprint(options);
+    if (d->m_optionsFingerprint != fingerprint) {
+        d->m_optionsFingerprint = fingerprint;
+        d->m_unit = SharedUnits::acquire(d->m_fileName, options);
     }
 }
 
@@ -152,16 +259,94 @@ void ClangCompleter::setSignalSlotCompletion(bool isSignalSlot)
     d->m_isSignalSlotCompletion = isSignalSlot;
 }
 
+bool ClangCompleter::isLoaded() const
+{
+    return d->m_unit.isLoaded();
+}
+
 bool ClangCompleter::reparse(const UnsavedFiles &unsavedFiles)
 {
+    QMutexLocker unitLock(d->m_unit.mutex());
     if (!d->m_unit.isLoaded())
         return d->parseFromFile(unsavedFiles);
+    if (d->m_unit.isParsedWith(unsavedFiles))
+        return true;
 
     d->m_unit.setUnsavedFiles(unsavedFiles);
     d->m_unit.reparse();
+    SharedUnits::parsed(d->m_unit);
     return d->m_unit.isLoaded();
 }
 
+bool ClangCompleter::warmUp(const UnsavedFiles &unsavedFiles)
+{
+    QMutexLocker unitLock(d->m_unit.mutex());
+    if (!d->m_unit.isLoaded() && !d->parseFromFile(unsavedFiles))
+        return false;
+    if (d->m_unit.isPrimed())
+        return true;
+
+    // Not skipped for unchanged contents, unlike reparse()
+    d->m_unit.setUnsavedFiles(unsavedFiles);
+    d->m_unit.reparse();
+    SharedUnits::parsed(d->m_unit);
+    return d->m_unit.isPrimed();
+}
+
+bool ClangCompleter::isWarm() const
+{
+    QMutexLocker unitLock(d->m_unit.mutex());
+    return d->m_unit.isPrimed();
+}
+
+quint64 ClangCompleter::startRequest(int revision, int position)
+{
+    QMutexLocker lock(&d->m_requestMutex);
+    const quint64 request = ++d->m_lastRequest;
+    if (revision != d->m_lastRevision || position != d->m_lastPosition) {
+        d->m_firstCurrentRequest = request;
+        d->m_lastRevision = revision;
+        d->m_lastPosition = position;
+        d->m_requestStarted.wakeAll();
+    }
+    return request;
+}
+
+bool ClangCompleter::isSuperseded(quint64 request) const
+{
+    QMutexLocker lock(&d->m_requestMutex);
+    return request < d->m_firstCurrentRequest;
+}
+
+bool ClangCompleter::waitForNewerRequest(quint64 request, int msecs) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker lock(&d->m_requestMutex);
+    while (request >= d->m_firstCurrentRequest) {
+        const qint64 remaining = msecs - timer.elapsed();
+        if (remaining <= 0)
+            return false;
+        d->m_requestStarted.wait(&d->m_requestMutex, static_cast<unsigned long>(remaining));
+    }
+    return true;
+}
+
+void ClangCompleter::addCompletionLatency(int msecs)
+{
+    QMutexLocker lock(&d->m_requestMutex);
+    d->m_averageLatency = d->m_averageLatency ? (3 * d->m_averageLatency + msecs) / 4 : msecs;
+}
+
+int ClangCompleter::coalescingWindow() const
+{
+    QMutexLocker lock(&d->m_requestMutex);
+    if (d->m_averageLatency < MIN_COALESCED_LATENCY)
+        return 0;
+    return qMin(d->m_averageLatency / 4, MAX_COALESCING_WINDOW);
+}
+
 QList<CodeCompletionResult> ClangCompleter::codeCompleteAt(unsigned line,
                                                            unsigned column,
                                                            const UnsavedFiles &unsavedFiles)
@@ -170,21 +355,22 @@ QList<CodeCompletionResult> ClangCompleter::codeCompleteAt(unsigned line,
     QTime t;t.start();
 #endif // TIME_COMPLETION
 
+    QMutexLocker unitLock(d->m_unit.mutex());
     if (!d->m_unit.isLoaded())
         if (!d->parseFromFile(unsavedFiles))
             return QList<CodeCompletionResult>();
 
-    ScopedCXCodeCompleteResults results;
     d->m_unit.setUnsavedFiles(unsavedFiles);
-    d->m_unit.codeCompleteAt(line, column, results);
+
+    // The initial parse is left out, it's a one-off.
+    QElapsedTimer latency;
+    latency.start();
 
     QList<CodeCompletionResult> completions;
-    if (results) {
-        const quint64 contexts = clang_codeCompleteGetContexts(results);
-        CompletionProposalsBuilder builder(completions, contexts, d->m_isSignalSlotCompletion);
-        for (unsigned i = 0; i < results.size(); ++i)
-            builder(results.completionAt(i));
-    }
+    if (!d->completeWithGlobalCache(line, column, unsavedFiles, &completions))
+        completions = d->complete(line, column, false);
+
+    addCompletionLatency(int(latency.elapsed()));
 
 #ifdef TIME_COMPLETION
     qDebug() << "Completion timing:" << completions.size() << "results in" << t.elapsed() << "ms.";
@@ -193,6 +379,308 @@ QList<CodeCompletionResult> ClangCompleter::codeCompleteAt(unsigned line,
     return completions;
 }
 
+QList<CodeCompletionResult> ClangCompleter::PrivateData::complete(unsigned line,
+                                                                 unsigned column,
+                                                                 bool skipPreamble,
+                                                                 CXCursorKind *containerKind,
+                                                                 QString *containerUsr)
+{
+    ScopedCXCodeCompleteResults results;
+    m_unit.codeCompleteAt(line, column, results, skipPreamble);
+
+    QList<CodeCompletionResult> completions;
+    if (!results)
+        return completions;
+
+    if (containerKind) {
+        unsigned isIncomplete = 0;
+        *containerKind = clang_codeCompleteGetContainerKind(results, &isIncomplete);
+        if (containerUsr)
+            *containerUsr = getQString(clang_codeCompleteGetContainerUSR(results));
+    }
+
+    const quint64 contexts = clang_codeCompleteGetContexts(results);
+    const unsigned count = results.size();
+    // The hint source takes over the results, so hints can be built on demand
+    QSharedPointer<CompletionHintSource> hintSource(
+                new CompletionHintSource(results.take(), contexts, m_isSignalSlotCompletion));
+    CompletionProposalsBuilder builder(completions, contexts, m_isSignalSlotCompletion,
+                                       hintSource);
+    for (unsigned i = 0; i < count; ++i)
+        builder(hintSource->completionAt(i));
+    return completions;
+}
+
+namespace {
+
+struct InclusionCollector
+{
+    static void visit(CXFile includedFile, CXSourceLocation *, unsigned includeLength,
+                      CXClientData clientData)
+    {
+        if (!includeLength) // The main file
+            return;
+
+        InclusionCollector *collector = static_cast<InclusionCollector *>(clientData);
+        const QString fileName = normalizeFileName(getQString(clang_getFileName(includedFile)));
+        collector->m_dependencies.insert(fileName);
+        if (includeLength == 1)
+            collector->m_includes.append(fileName);
+    }
+
+    QStringList m_includes;
+    QSet<QString> m_dependencies;
+};
+
+// Using directives make names of the preamble visible unqualified, they must be part of the
+// key although the file-local results don't show them.
+QByteArray usingDirectives(const QByteArray &contents)
+{
+    QByteArray directives;
+    foreach (const QByteArray &line, contents.split('\n')) {
+        const QByteArray trimmed = line.simplified();
+        if (trimmed.startsWith("using namespace ")) {
+            directives += trimmed;
+            directives += '\n';
+        }
+    }
+    return directives;
+}
+
+// Macros defined or undefined ahead of an #include change what the header declares,
+// without the list of included files telling. Those directives must be part of the key.
+QByteArray preambleMacroDirectives(const QByteArray &contents)
+{
+    QByteArray directives;
+    QByteArray pending;
+    bool continued = false;
+    foreach (const QByteArray &line, contents.split('\n')) {
+        const QByteArray trimmed = line.simplified();
+        if (continued) {
+            pending += trimmed;
+            continued = trimmed.endsWith('\\');
+            continue;
+        }
+        if (!trimmed.startsWith('#'))
+            continue;
+
+        const QByteArray directive = trimmed.mid(1).trimmed();
+        if (directive.startsWith("include") || directive.startsWith("import")) {
+            directives += pending;
+            pending.clear();
+        } else if (directive.startsWith("define") || directive.startsWith("undef")) {
+            pending += '#' + directive + '\n';
+            continued = trimmed.endsWith('\\');
+        }
+    }
+    return directives;
+}
+
+} // Anonymous
+
+/**
+ * @brief Completes the file-local declarations and takes the others from the global cache
+ *
+ * Returns false when the position isn't at namespace scope, or the cache can't be used for
+ * another reason, e.g. when an included header is being edited.
+ */
+bool ClangCompleter::PrivateData::completeWithGlobalCache(unsigned line, unsigned column,
+                                                          const UnsavedFiles &unsavedFiles,
+                                                          QList<CodeCompletionResult> *completions)
+{
+    if (!m_globalCache || m_isSignalSlotCompletion || !GlobalCompletionCache::isSupported())
+        return false;
+
+    QString scopeUsr;
+    if (!namespaceScope(line, column, &scopeUsr))
+        return false;
+
+    InclusionCollector inclusions;
+    m_unit.getInclusions(&InclusionCollector::visit, &inclusions);
+    // The cached results reflect the headers on disk, not the edited ones.
+    foreach (const QString &fileName, unsavedFiles.keys()) {
+        if (fileName != m_fileName && inclusions.m_dependencies.contains(fileName))
+            return false;
+    }
+
+    CXCursorKind containerKind = CXCursor_InvalidCode;
+    QString containerUsr;
+    const QList<CodeCompletionResult> local = complete(line, column, true,
+                                                       &containerKind, &containerUsr);
+    // Member completion and the like depend on the preamble in other ways.
+    if (containerKind != CXCursor_InvalidCode && containerKind != CXCursor_Namespace)
+        return false;
+
+    QByteArray contents = unsavedFiles.value(m_fileName);
+    if (contents.isNull()) {
+        QFile file(m_fileName);
+        if (file.open(QIODevice::ReadOnly))
+            contents = file.readAll();
+    }
+
+    QByteArray container = scopeUsr.toUtf8() + '\n' + containerUsr.toUtf8() + '\n';
+    container += usingDirectives(contents);
+    container += preambleMacroDirectives(contents);
+    const QByteArray key = GlobalCompletionCache::key(m_pchFingerprint,
+                                                      m_unit.compilationOptions(),
+                                                      inclusions.m_includes, container);
+
+    QList<CodeCompletionResult> globals;
+    if (m_globalCache->lookup(key, &globals)) {
+        *completions = local + globals;
+        return true;
+    }
+
+    *completions = complete(line, column, false);
+    m_globalCache->insert(key, inclusions.m_dependencies.toList(),
+                          GlobalCompletionCache::difference(*completions, local));
+    return true;
+}
+
+/**
+ * @brief Tells whether \a line and \a column are at namespace scope in the parsed unit
+ * @param scopeUsr The innermost enclosing namespace, empty for the global namespace
+ */
+bool ClangCompleter::PrivateData::namespaceScope(unsigned line, unsigned column,
+                                                 QString *scopeUsr) const
+{
+    const CXSourceLocation location = m_unit.getLocation(m_unit.getFile(), line, column);
+    CXCursor cursor = m_unit.getCursor(location);
+
+    // Nothing at that position, e.g. after the last declaration.
+    if (clang_equalCursors(cursor, clang_getNullCursor())
+            || clang_isInvalid(clang_getCursorKind(cursor))) {
+        return true;
+    }
+
+    for (;;) {
+        switch (clang_getCursorKind(cursor)) {
+        case CXCursor_TranslationUnit:
+            return true;
+        case CXCursor_Namespace:
+            if (scopeUsr->isEmpty())
+                *scopeUsr = getQString(clang_getCursorUSR(cursor));
+            cursor = clang_getCursorSemanticParent(cursor);
+            break;
+        default:
+            // Function and class bodies, and everything else.
+            return false;
+        }
+    }
+}
+
+void ClangCompleter::setGlobalCompletionCache(Internal::GlobalCompletionCache *cache,
+                                              const QByteArray &pchFingerprint)
+{
+    d->m_globalCache = cache;
+    d->m_pchFingerprint = pchFingerprint;
+}
+
+namespace {
+
+struct OverloadCollector
+{
+    OverloadCollector(const QString &name, bool constructors)
+        : m_name(name)
+        , m_constructors(constructors)
+    {}
+
+    static CXChildVisitResult visit(CXCursor cursor, CXCursor, CXClientData clientData)
+    {
+        OverloadCollector *collector = static_cast<OverloadCollector *>(clientData);
+        switch (cursor.kind) {
+        case CXCursor_Constructor:
+            if (collector->m_constructors)
+                collector->m_decls.append(cursor);
+            break;
+        case CXCursor_CXXMethod:
+        case CXCursor_FunctionTemplate:
+            if (!collector->m_constructors
+                    && Internal::getQString(clang_getCursorSpelling(cursor)) == collector->m_name)
+                collector->m_decls.append(cursor);
+            break;
+        default:
+            break;
+        }
+        return CXChildVisit_Continue;
+    }
+
+    QString m_name;
+    bool m_constructors;
+    QList<CXCursor> m_decls;
+};
+
+static bool isClass(CXCursorKind kind)
+{
+    return kind == CXCursor_ClassDecl
+            || kind == CXCursor_StructDecl
+            || kind == CXCursor_ClassTemplate
+            || kind == CXCursor_ClassTemplatePartialSpecialization;
+}
+
+} // Anonymous
+
+QList<CodeCompletionResult> ClangCompleter::overloadsAt(unsigned line,
+                                                        unsigned column,
+                                                        const QString &functionName)
+{
+    QList<CodeCompletionResult> completions;
+    QMutexLocker unitLock(d->m_unit.mutex());
+    if (!d->m_unit.isLoaded())
+        return completions;
+
+    const CXSourceLocation location = d->m_unit.getLocation(d->m_unit.getFile(), line, column);
+    const CXCursor cursor = d->m_unit.getCursor(location);
+    const CXCursor referenced = clang_getCursorReferenced(cursor);
+    if (clang_equalCursors(referenced, clang_getNullCursor())
+            || getQString(clang_getCursorSpelling(referenced)) != functionName) {
+        return completions;
+    }
+
+    QList<CXCursor> decls;
+    if (referenced.kind == CXCursor_OverloadedDeclRef) {
+        // Unresolved, clang hands over the whole overload set.
+        for (unsigned i = 0, ei = clang_getNumOverloadedDecls(referenced); i < ei; ++i)
+            decls.append(clang_getOverloadedDecl(referenced, i));
+    } else {
+        // Members are complete within their class definition, other scopes can be reopened.
+        CXCursor scope;
+        bool constructors = false;
+        if (isClass(referenced.kind)) {
+            scope = referenced;
+            constructors = true;
+        } else if (referenced.kind == CXCursor_CXXMethod
+                   || referenced.kind == CXCursor_Constructor
+                   || referenced.kind == CXCursor_FunctionTemplate) {
+            scope = clang_getCursorSemanticParent(referenced);
+            constructors = referenced.kind == CXCursor_Constructor;
+            if (!isClass(scope.kind))
+                return completions;
+        } else {
+            return completions;
+        }
+
+        const CXCursor definition = clang_getCursorDefinition(scope);
+        if (!clang_equalCursors(definition, clang_getNullCursor()))
+            scope = definition;
+
+        OverloadCollector collector(functionName, constructors);
+        clang_visitChildren(scope, &OverloadCollector::visit, &collector);
+        decls = collector.m_decls;
+    }
+
+    CompletionProposalsBuilder builder(completions, 0, d->m_isSignalSlotCompletion);
+    foreach (const CXCursor &decl, decls) {
+        CXCompletionResult result;
+        result.CursorKind = decl.kind;
+        result.CompletionString = clang_getCursorCompletionString(decl);
+        if (result.CompletionString)
+            builder(result);
+    }
+
+    return completions;
+}
+
 bool ClangCompleter::objcEnabled() const
 {
     static const QString objcppOption = QLatin1String("-ObjC++");
@@ -35,6 +35,7 @@
 #include "sourcelocation.h"
 #include "utils.h"
 
+#include <QDataStream>
 #include <QList>
 #include <QMap>
 #include <QMutex>
@@ -46,8 +47,13 @@
 
 namespace ClangCodeModel {
 
+class CompletionHintSource;
 class SourceMarker;
 
+namespace Internal {
+class GlobalCompletionCache;
+}
+
 class CLANG_EXPORT CodeCompletionResult
 {
 public:
@@ -91,10 +97,16 @@ public:
     void setText(const QString &text)
     { m_text = text; }
 
-    QString hint() const
-    { return m_hint; }
+    QString hint() const;
     void setHint(const QString &hint)
-    { m_hint = hint; }
+    { m_hint = hint; m_hintSource.clear(); }
+
+    /**
+     * The hint is built from \a source on first access. Until then only the
+     * index of the libclang result and the optional chunks variant are kept.
+     */
+    void setHintSource(const QSharedPointer<CompletionHintSource> &source,
+                       unsigned index, int variant);
 
     QString snippet() const
     { return m_snippet; }
@@ -123,10 +135,9 @@ public:
         else if (m_text > other.m_text)
             return 1;
 
-        if (m_hint < other.m_hint)
-            return -1;
-        else if (m_hint > other.m_hint)
-            return 1;
+        const int hintOrder = compareHints(other);
+        if (hintOrder)
+            return hintOrder;
 
         if (!m_hasParameters && other.m_hasParameters)
             return -1;
@@ -152,10 +163,15 @@ public:
     { m_availability = availability; }
 
 private:
+    int compareHints(const CodeCompletionResult &other) const;
+
     unsigned m_priority;
     Kind m_completionKind;
     QString m_text;
     QString m_hint;
+    QSharedPointer<CompletionHintSource> m_hintSource;
+    unsigned m_hintIndex;
+    int m_hintVariant;
     QString m_snippet;
     Availability m_availability;
     bool m_hasParameters;
@@ -172,6 +188,10 @@ inline CLANG_EXPORT bool operator<(const CodeCompletionResult &ccr1, const CodeC
     return ccr1.compare(ccr2) < 0;
 }
 
+// Hints are written out, results read back have them built already.
+CLANG_EXPORT QDataStream &operator<<(QDataStream &stream, const CodeCompletionResult &ccr);
+CLANG_EXPORT QDataStream &operator>>(QDataStream &stream, CodeCompletionResult &ccr);
+
 class CLANG_EXPORT ClangCompleter
 {
     Q_DISABLE_COPY(ClangCompleter)
@@ -194,8 +214,55 @@ public: // methods
     bool isSignalSlotCompletion() const;
     void setSignalSlotCompletion(bool isSignalSlot);
 
+    /**
+     * At namespace scope, the results coming from the PCH and the preamble are then taken
+     * from \a cache, and libclang only completes the file-local declarations. A null
+     * \a cache turns this off.
+     */
+    void setGlobalCompletionCache(Internal::GlobalCompletionCache *cache,
+                                  const QByteArray &pchFingerprint);
+
+    bool isLoaded() const;
     bool reparse(const Internal::UnsavedFiles &unsavedFiles);
 
+    /**
+     * Parses the file if needed, and reparses it once more even if the contents didn't
+     * change: the first reparse is the one building the precompiled preamble and the
+     * cached completion results, so the first completion doesn't pay for them.
+     */
+    bool warmUp(const Internal::UnsavedFiles &unsavedFiles);
+    bool isWarm() const;
+
+    /**
+     * Tags a completion request with the document revision and cursor position it was
+     * made for. Starting a request for another revision or position supersedes all
+     * earlier requests. Repeating the latest one doesn't, so the repeated request can
+     * still profit from the running one.
+     */
+    quint64 startRequest(int revision, int position);
+
+    /**
+     * Returns true if a newer request has been started after \a request. Its results
+     * would be thrown away, so it shouldn't start any more work.
+     */
+    bool isSuperseded(quint64 request) const;
+
+    /**
+     * Waits up to \a msecs for a request superseding \a request. Returns true if one came,
+     * so typing fast or pasting only completes for the last keystroke.
+     */
+    bool waitForNewerRequest(quint64 request, int msecs) const;
+
+    /**
+     * How long a request triggered while typing should wait for the next keystroke, in ms.
+     * Adapts to how long completion took for this file recently: waiting a little is cheap
+     * compared to a slow completion nobody gets to see, but not when completion is fast.
+     */
+    int coalescingWindow() const;
+
+    // For completions done elsewhere, e.g. in the backend process.
+    void addCompletionLatency(int msecs);
+
     /**
      * Do code-completion at the specified position.
      *
@@ -208,6 +275,20 @@ public: // methods
                                                unsigned column,
                                                const Internal::UnsavedFiles &unsavedFiles);
 
+    /**
+     * Find the overloads of the function named at the specified position by looking at the
+     * already parsed unit, without a new code-completion pass. This is used for function
+     * hints, so the results look like the ones from codeCompleteAt().
+     *
+     * Returns an empty list when the unit is not loaded, when the name at that position
+     * doesn't match (the unit lags behind the editor), or when the overload set cannot be
+     * determined reliably from the unit, e.g. for free functions that may be overloaded in
+     * other scopes. Callers are expected to fall back to codeCompleteAt() then.
+     */
+    QList<CodeCompletionResult> overloadsAt(unsigned line,
+                                            unsigned column,
+                                            const QString &functionName);
+
     bool objcEnabled() const;
 
     QMutex *mutex() const;
@@ -29,15 +29,27 @@
 
 #include "clangcompletion.h"
 #include "clangutils.h"
+#include "completionresultscache.h"
+#include "completionservice.h"
+#include "globalcompletioncache.h"
+#include "includepathcache.h"
+#include "completionunitpool.h"
+#include "fastindexer.h"
 #include "pchmanager.h"
 
+#include <coreplugin/editormanager/editormanager.h>
 #include <coreplugin/icore.h>
 #include <coreplugin/idocument.h>
 #include <coreplugin/mimedatabase.h>
 
 #include <cplusplus/BackwardsScanner.h>
 #include <cplusplus/ExpressionUnderCursor.h>
+#include <cplusplus/LookupContext.h>
+#include <cplusplus/Overview.h>
+#include <cplusplus/ResolveExpression.h>
+#include <cplusplus/Symbols.h>
 #include <cplusplus/Token.h>
+#include <cplusplus/TypeOfExpression.h>
 #include <cplusplus/MatchingText.h>
 
 #include <cppeditor/cppeditorconstants.h>
@@ -57,6 +69,12 @@
 
 #include <QCoreApplication>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSettings>
+#include <QTextBlock>
+#include <QThread>
 #include <QTextCursor>
 #include <QTextDocument>
 
@@ -70,6 +88,19 @@ using namespace TextEditor;
 
 static const char SNIPPET_ICON_PATH[] = ":/texteditor/images/snippet.png";
 
+// Typing pause after which the edited files are reparsed in the background, in ms.
+static const int IDLE_REPARSE_DELAY = 500;
+
+// Off by default: the backend parses every file a second time, next to the unit highlighting
+// already keeps in Creator, and skips the unit pool, the warm-up, the idle reparse and the
+// lazy hints. Worth it only where a libclang crash must not take Creator down.
+static const char kOutOfProcessCompletionKey[] = "ClangCodeModel/OutOfProcessCompletion";
+static const char kCompletionTimeoutKey[] = "ClangCodeModel/CompletionTimeoutMs";
+
+// What libclang gives member declarations (CCP_MemberDeclaration), so the indexed members
+// sort like the results replacing them.
+static const int INDEXED_MEMBER_PRIORITY = 35;
+
 namespace {
 
 int activationSequenceChar(const QChar &ch,
@@ -149,31 +180,104 @@ int activationSequenceChar(const QChar &ch,
     return referencePosition;
 }
 
+// The caller holds the completer's mutex.
+static QList<CodeCompletionResult> completeAt(const ClangCompleter::Ptr &wrapper,
+                                              const QString &fileName,
+                                              const QStringList &options,
+                                              GlobalCompletionCache *globalCache,
+                                              const QByteArray &pchFingerprint,
+                                              const UnsavedFiles &unsavedFiles,
+                                              unsigned line, unsigned column,
+                                              bool isSignalSlotCompletion = false)
+{
+    wrapper->setFileName(fileName);
+    wrapper->setOptions(options);
+    wrapper->setSignalSlotCompletion(isSignalSlotCompletion);
+    wrapper->setGlobalCompletionCache(globalCache, pchFingerprint);
+
+    // Not sorted here: callers only sort what they show
+    return wrapper->codeCompleteAt(line, column + 1, unsavedFiles);
+}
+
+static CompletionServiceRequest serviceRequest(const QString &fileName,
+                                               const QStringList &options,
+                                               const UnsavedFiles &unsavedFiles)
+{
+    CompletionServiceRequest request;
+    request.m_fileName = fileName;
+    request.m_options = options;
+    request.m_unsavedFiles = unsavedFiles;
+    return request;
+}
+
+// Returns false if there is no backend to complete in, the caller completes in-process then.
+static bool completeInBackend(CompletionService *service,
+                              const QString &fileName,
+                              const QStringList &options,
+                              const QByteArray &pchFingerprint,
+                              const UnsavedFiles &unsavedFiles,
+                              unsigned line, unsigned column,
+                              bool isSignalSlotCompletion,
+                              QList<CodeCompletionResult> *results)
+{
+    if (!service)
+        return false;
+
+    CompletionServiceRequest request = serviceRequest(fileName, options, unsavedFiles);
+    request.m_line = line;
+    request.m_column = column + 1;
+    request.m_isSignalSlotCompletion = isSignalSlotCompletion;
+    request.m_pchFingerprint = pchFingerprint;
+    return service->complete(request, results);
+}
+
 static QList<CodeCompletionResult> unfilteredCompletion(const ClangCompletionAssistInterface* interface,
                                                         const QString &fileName,
                                                         unsigned line, unsigned column,
                                                         QByteArray modifiedInput = QByteArray(),
                                                         bool isSignalSlotCompletion = false)
 {
+    // Don't queue behind the running libclang call if our results would be dropped anyway
+    if (interface->isSuperseded())
+        return QList<CodeCompletionResult>();
+
     ClangCompleter::Ptr wrapper = interface->clangWrapper();
-    QMutexLocker lock(wrapper->mutex());
-    //### TODO: check if we're cancelled after we managed to aquire the mutex
 
-    wrapper->setFileName(fileName);
-    wrapper->setOptions(interface->options());
-    wrapper->setSignalSlotCompletion(isSignalSlotCompletion);
+    // While typing fast or pasting, every character may trigger completion. Give the next
+    // keystroke a moment to arrive, so only the request the user gets to see is completed.
+    if (interface->reason() != ExplicitlyInvoked) {
+        const int window = wrapper->coalescingWindow();
+        if (window > 0 && wrapper->waitForNewerRequest(interface->request(), window))
+            return QList<CodeCompletionResult>();
+    }
+
     UnsavedFiles unsavedFiles = interface->unsavedFiles();
     if (!modifiedInput.isEmpty())
         unsavedFiles.insert(fileName, modifiedInput);
 
+    QList<CodeCompletionResult> result;
+    QElapsedTimer latency;
+    latency.start();
+    if (completeInBackend(interface->completionService(), fileName, interface->options(),
+                          interface->pchFingerprint(), unsavedFiles, line, column,
+                          isSignalSlotCompletion, &result)) {
+        wrapper->addCompletionLatency(int(latency.elapsed()));
+        return result;
+    }
+
+    QMutexLocker lock(wrapper->mutex());
+    if (interface->isSuperseded())
+        return QList<CodeCompletionResult>();
+
 #ifdef DEBUG_TIMING
     qDebug() << "Here we go with ClangCompletionAssistProcessor....";
     QTime t;
     t.start();
 #endif // DEBUG_TIMING
 
-    QList<CodeCompletionResult> result = wrapper->codeCompleteAt(line, column + 1, unsavedFiles);
-    qSort(result);
+    result = completeAt(wrapper, fileName, interface->options(), interface->globalCache(),
+                        interface->pchFingerprint(), unsavedFiles, line, column,
+                        isSignalSlotCompletion);
 
 #ifdef DEBUG_TIMING
     qDebug() << "... Completion done in" << t.elapsed() << "ms, with" << result.count() << "items.";
@@ -182,6 +286,289 @@ static QList<CodeCompletionResult> unfilteredCompletion(const ClangCompletionAss
     return result;
 }
 
+static CompletionResultsCache::Context cacheContext(const ClangCompletionAssistInterface *interface,
+                                                   const QString &fileName,
+                                                   unsigned line, unsigned column,
+                                                   int startOfName)
+{
+    CompletionResultsCache::Context context;
+    context.m_fileName = fileName;
+    context.m_options = normalizedOptions(interface->options());
+    context.m_line = line;
+    context.m_column = column;
+    context.m_revision = interface->revision();
+    context.m_characterCount = interface->characterCount();
+    context.m_prefix = interface->textAt(startOfName, interface->position() - startOfName);
+    return context;
+}
+
+// Overloads for a function hint, preferably without another pass through libclang: the
+// name was most likely just completed at the same position, or else the parsed unit knows.
+static QList<CodeCompletionResult> functionOverloads(const ClangCompletionAssistInterface *interface,
+                                                     const QString &fileName,
+                                                     unsigned line, unsigned column,
+                                                     int startOfName,
+                                                     const QString &functionName)
+{
+    QList<CodeCompletionResult> result;
+    if (CompletionResultsCache *cache = interface->resultsCache()) {
+        if (cache->peek(cacheContext(interface, fileName, line, column, startOfName), &result))
+            return result;
+    }
+
+    if (interface->isSuperseded())
+        return result;
+
+    {
+        ClangCompleter::Ptr wrapper = interface->clangWrapper();
+        QMutexLocker lock(wrapper->mutex());
+        wrapper->setSignalSlotCompletion(false);
+        result = wrapper->overloadsAt(line, column + 1, functionName);
+    }
+    if (!result.isEmpty())
+        return result;
+
+    return unfilteredCompletion(interface, fileName, line, column);
+}
+
+static void completionOptions(const QString &fileName,
+                              QStringList *options,
+                              QStringList *includePaths,
+                              QStringList *frameworkPaths,
+                              PCHInfo::Ptr *pchInfo)
+{
+    CppModelManagerInterface *modelManager = CppModelManagerInterface::instance();
+    QList<ProjectPart::Ptr> parts = modelManager->projectPart(fileName);
+    if (parts.isEmpty())
+        parts += modelManager->fallbackProjectPart();
+    foreach (ProjectPart::Ptr part, parts) {
+        if (part.isNull())
+            continue;
+        *options = ClangCodeModel::Utils::createClangOptions(part, fileName);
+        *pchInfo = PCHManager::instance()->pchInfo(part);
+        if (!pchInfo->isNull())
+            options->append(ClangCodeModel::Utils::createPCHInclusionOptions((*pchInfo)->fileName()));
+        *includePaths = part->includePaths;
+        *frameworkPaths = part->frameworkPaths;
+        break;
+    }
+}
+
+class WarmUpJob : public QRunnable
+{
+public:
+    WarmUpJob(const ClangCompleter::Ptr &completer,
+              const UnsavedFiles &unsavedFiles,
+              const PCHInfo::Ptr &pchInfo)
+        : m_completer(completer)
+        , m_unsavedFiles(unsavedFiles)
+        , m_pchInfo(pchInfo)
+    {}
+
+    void run()
+    {
+        QMutexLocker lock(m_completer->mutex());
+
+        // Already warm, e.g. a completion or highlighting got here first.
+        if (m_completer->isWarm())
+            return;
+
+        m_completer->warmUp(m_unsavedFiles);
+    }
+
+private:
+    ClangCompleter::Ptr m_completer;
+    UnsavedFiles m_unsavedFiles;
+    PCHInfo::Ptr m_pchInfo; // Keeps the PCH file alive while parsing.
+};
+
+int loadRevision(const QAtomicInt &revision)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    return revision.load();
+#else
+    return revision;
+#endif
+}
+
+class IdleReparseJob : public QRunnable
+{
+public:
+    IdleReparseJob(const ClangCompleter::Ptr &completer,
+                   const UnsavedFiles &unsavedFiles,
+                   const PCHInfo::Ptr &pchInfo,
+                   const QAtomicInt *editRevision)
+        : m_completer(completer)
+        , m_unsavedFiles(unsavedFiles)
+        , m_pchInfo(pchInfo)
+        , m_editRevision(editRevision)
+        , m_revision(loadRevision(*editRevision))
+    {}
+
+    void run()
+    {
+        if (isSuperseded())
+            return;
+
+        QThread *thread = QThread::currentThread();
+        const QThread::Priority priority = thread->priority();
+        thread->setPriority(QThread::LowPriority);
+
+        {
+            QMutexLocker lock(m_completer->mutex());
+
+            // The user resumed typing while we waited, the contents we have are stale. Units
+            // not parsed yet are left to warming up or to the first request. Once libclang
+            // is reparsing, it can't be interrupted.
+            if (!isSuperseded() && m_completer->isLoaded())
+                m_completer->reparse(m_unsavedFiles);
+        }
+
+        thread->setPriority(priority);
+    }
+
+private:
+    bool isSuperseded() const
+    { return loadRevision(*m_editRevision) != m_revision; }
+
+    ClangCompleter::Ptr m_completer;
+    UnsavedFiles m_unsavedFiles;
+    PCHInfo::Ptr m_pchInfo; // Keeps the PCH file alive while parsing.
+    const QAtomicInt *m_editRevision;
+    const int m_revision;
+};
+
+// Asks libclang for the members shown from the index meanwhile. The results go to the
+// results cache, where the re-invoked completion finds them.
+class BackgroundCompletionJob : public QRunnable
+{
+public:
+    BackgroundCompletionJob(const ClangCompletionAssistInterface *interface,
+                            unsigned line, unsigned column,
+                            const CompletionResultsCache::Context &context)
+        : m_completer(interface->clangWrapper())
+        , m_fileName(interface->fileName())
+        , m_options(interface->options())
+        , m_unsavedFiles(interface->unsavedFiles())
+        , m_pchInfo(interface->pchInfo())
+        , m_globalCache(interface->globalCache())
+        , m_completionService(interface->completionService())
+        , m_pchFingerprint(interface->pchFingerprint())
+        , m_resultsCache(interface->resultsCache())
+        , m_provider(interface->provider())
+        , m_context(context)
+        , m_line(line)
+        , m_column(column)
+        , m_position(interface->position())
+        , m_request(interface->request())
+    {}
+
+    void run()
+    {
+        // An earlier job may have answered already, e.g. while the user narrowed the prefix.
+        QList<CodeCompletionResult> completions;
+        if (!m_resultsCache->peek(m_context, &completions)) {
+            if (m_completer->isSuperseded(m_request))
+                return;
+
+            if (!completeInBackend(m_completionService, m_fileName, m_options,
+                                   m_pchFingerprint, m_unsavedFiles, m_line, m_column,
+                                   false, &completions)) {
+                QMutexLocker lock(m_completer->mutex());
+                if (m_completer->isSuperseded(m_request))
+                    return;
+
+                completions = completeAt(m_completer, m_fileName, m_options,
+                                         m_globalCache, m_pchFingerprint, m_unsavedFiles,
+                                         m_line, m_column);
+            }
+
+            // Better keep the indexed members than show nothing, e.g. after a timeout.
+            if (completions.isEmpty())
+                return;
+            m_resultsCache->insert(m_context, completions);
+        }
+
+        if (m_completer->isSuperseded(m_request))
+            return;
+        QMetaObject::invokeMethod(m_provider, "backgroundCompletionFinished",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QString, m_fileName),
+                                  Q_ARG(int, m_context.m_revision),
+                                  Q_ARG(int, m_position));
+    }
+
+private:
+    ClangCompleter::Ptr m_completer;
+    QString m_fileName;
+    QStringList m_options;
+    UnsavedFiles m_unsavedFiles;
+    PCHInfo::Ptr m_pchInfo; // Keeps the PCH file alive while parsing.
+    GlobalCompletionCache *m_globalCache;
+    CompletionService *m_completionService;
+    QByteArray m_pchFingerprint;
+    CompletionResultsCache *m_resultsCache;
+    ClangCompletionAssistProvider *m_provider;
+    CompletionResultsCache::Context m_context;
+    unsigned m_line;
+    unsigned m_column;
+    int m_position;
+    quint64 m_request;
+};
+
+// Qualified name of the class whose members the expression before "." or "->" accesses,
+// as far as the built-in code model can tell.
+QString receiverClass(const QString &fileName, QTextDocument *document,
+                      const QString &expression, int endOfExpression, unsigned accessOperator)
+{
+    const Snapshot snapshot = CppModelManagerInterface::instance()->snapshot();
+    Document::Ptr thisDocument = snapshot.document(fileName);
+    if (!thisDocument)
+        return QString();
+
+    int line = 0, column = 0;
+    Convenience::convertPosition(document, endOfExpression, &line, &column);
+    Scope *scope = thisDocument->scopeAt(line, column);
+    if (!scope)
+        return QString();
+
+    TypeOfExpression typeOfExpression;
+    typeOfExpression.init(thisDocument, snapshot);
+    const QList<LookupItem> results = typeOfExpression(expression.toUtf8(), scope,
+                                                       TypeOfExpression::Preprocess);
+    if (results.isEmpty())
+        return QString();
+
+    ResolveExpression resolveExpression(typeOfExpression.context());
+    ClassOrNamespace *binding = resolveExpression.baseExpression(results, accessOperator);
+    if (!binding)
+        return QString();
+
+    foreach (CPlusPlus::Symbol *symbol, binding->symbols()) {
+        if (Class *klass = symbol->asClass()) {
+            const QList<const Name *> names = LookupContext::fullyQualifiedName(klass);
+            QStringList qualification;
+            Overview overview;
+            foreach (const Name *name, names)
+                qualification.append(overview.prettyName(name));
+            return qualification.join(QLatin1String("::"));
+        }
+    }
+    return QString();
+}
+
+// "operator+", "operator bool" and the like, but not "operatorName".
+bool isOperatorName(const QString &name)
+{
+    const QString prefix = QLatin1String("operator");
+    if (!name.startsWith(prefix))
+        return false;
+    if (name.size() == prefix.size())
+        return true;
+    const QChar next = name.at(prefix.size());
+    return !next.isLetterOrNumber() && next != QLatin1Char('_');
+}
+
 } // Anonymous
 
 namespace ClangCodeModel {
@@ -190,9 +577,157 @@ namespace Internal {
 // -----------------------------
 // ClangCompletionAssistProvider
 // -----------------------------
-ClangCompletionAssistProvider::ClangCompletionAssistProvider()
-    : m_clangCompletionWrapper(new ClangCodeModel::ClangCompleter)
+ClangCompletionAssistProvider::ClangCompletionAssistProvider(FastIndexer *fastIndexer)
+    : m_unitPool(new CompletionUnitPool)
+    , m_resultsCache(new CompletionResultsCache)
+    , m_includePathCache(new IncludePathCache)
+    , m_globalCache(new GlobalCompletionCache(Core::ICore::userResourcePath()
+                                              + QLatin1String("/codemodel/completion")))
+    , m_fastIndexer(fastIndexer)
+{
+    QSettings *settings = Core::ICore::settings();
+    if (settings->value(QLatin1String(kOutOfProcessCompletionKey), false).toBool()) {
+        m_completionService.reset(new CompletionService(CompletionService::defaultBackendPath(),
+                                                        QStringList(m_globalCache->directory())));
+        m_completionService->setTimeout(settings->value(
+                QLatin1String(kCompletionTimeoutKey),
+                int(CompletionService::DefaultTimeoutMs)).toInt());
+    }
+
+    // Warming up is only worth it for a single file at a time, the editor the user is
+    // looking at is the one that matters.
+    m_warmUpPool.setMaxThreadCount(1);
+    // Only the latest request matters, older ones give up once superseded.
+    m_backgroundCompletionPool.setMaxThreadCount(1);
+
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(IDLE_REPARSE_DELAY);
+    connect(&m_idleTimer, SIGNAL(timeout()), this, SLOT(reparseEditedFiles()));
+
+    // Not on editorOpened: restoring a session opens all of its editors at once, while only
+    // the visible one is about to be completed in.
+    connect(Core::EditorManager::instance(), SIGNAL(currentEditorChanged(Core::IEditor*)),
+            this, SLOT(warmUp(Core::IEditor*)));
+    connect(CppModelManagerInterface::instance(),
+            SIGNAL(projectPartsUpdated(ProjectExplorer::Project*)),
+            this, SLOT(prefetchIncludePaths(ProjectExplorer::Project*)));
+}
+
+ClangCompletionAssistProvider::~ClangCompletionAssistProvider()
+{
+    m_warmUpPool.clear();
+    m_warmUpPool.waitForDone();
+    m_backgroundCompletionPool.clear();
+    m_backgroundCompletionPool.waitForDone();
+}
+
+CompletionService *ClangCompletionAssistProvider::completionService() const
+{
+    if (m_completionService && m_completionService->isAvailable())
+        return m_completionService.data();
+    return 0;
+}
+
+CompletionUnitPool *ClangCompletionAssistProvider::unitPool() const
 {
+    return m_unitPool.data();
+}
+
+void ClangCompletionAssistProvider::startBackgroundCompletion(QRunnable *job)
+{
+    m_backgroundCompletionPool.start(job);
+}
+
+void ClangCompletionAssistProvider::warmUp(Core::IEditor *editor)
+{
+    if (!editor || !editor->document())
+        return;
+
+    // Only for editors that complete through us, e.g. not with the built-in model.
+    CppModelManagerInterface *modelManager = CppModelManagerInterface::instance();
+    if (modelManager->completionAssistProvider(editor) != this)
+        return;
+
+    const QString fileName = editor->document()->filePath();
+    if (fileName.isEmpty())
+        return;
+
+    connect(editor, SIGNAL(contentsChanged()), this, SLOT(documentEdited()),
+            Qt::UniqueConnection);
+
+    QStringList includePaths, frameworkPaths, options;
+    PCHInfo::Ptr pchInfo;
+    completionOptions(fileName, &options, &includePaths, &frameworkPaths, &pchInfo);
+
+    m_includePathCache->prefetch(includePaths + frameworkPaths);
+
+    const UnsavedFiles &unsavedFiles = Utils::createUnsavedFiles(modelManager->workingCopy());
+    if (CompletionService *service = completionService()) {
+        service->parse(serviceRequest(fileName, options, unsavedFiles));
+        return;
+    }
+
+    ClangCompleter::Ptr completer = m_unitPool->completer(fileName, options);
+    m_warmUpPool.start(new WarmUpJob(completer, unsavedFiles, pchInfo));
+}
+
+void ClangCompletionAssistProvider::prefetchIncludePaths(ProjectExplorer::Project *project)
+{
+    CppModelManagerInterface *modelManager = CppModelManagerInterface::instance();
+    foreach (const ProjectPart::Ptr &part, modelManager->projectInfo(project).projectParts())
+        m_includePathCache->prefetch(part->includePaths + part->frameworkPaths);
+}
+
+void ClangCompletionAssistProvider::documentEdited()
+{
+    Core::IEditor *editor = qobject_cast<Core::IEditor *>(sender());
+    if (!editor || !editor->document())
+        return;
+
+    // Invalidates the idle reparses not started yet.
+    m_editRevision.ref();
+    m_editedFiles.insert(editor->document()->filePath());
+    m_idleTimer.start();
+}
+
+void ClangCompletionAssistProvider::reparseEditedFiles()
+{
+    if (m_editedFiles.isEmpty())
+        return;
+
+    CppModelManagerInterface *modelManager = CppModelManagerInterface::instance();
+    const UnsavedFiles &unsavedFiles = Utils::createUnsavedFiles(modelManager->workingCopy());
+
+    foreach (const QString &fileName, m_editedFiles) {
+        QStringList includePaths, frameworkPaths, options;
+        PCHInfo::Ptr pchInfo;
+        completionOptions(fileName, &options, &includePaths, &frameworkPaths, &pchInfo);
+
+        if (CompletionService *service = completionService()) {
+            service->parse(serviceRequest(fileName, options, unsavedFiles));
+            continue;
+        }
+
+        ClangCompleter::Ptr completer = m_unitPool->completer(fileName, options);
+        m_warmUpPool.start(new IdleReparseJob(completer, unsavedFiles, pchInfo, &m_editRevision));
+    }
+    m_editedFiles.clear();
+}
+
+void ClangCompletionAssistProvider::backgroundCompletionFinished(const QString &fileName,
+                                                                 int revision, int position)
+{
+    BaseTextEditor *editor = qobject_cast<BaseTextEditor *>(Core::EditorManager::currentEditor());
+    if (!editor || editor->document()->filePath() != fileName)
+        return;
+
+    // Once the user typed on, the preliminary proposal asked again by itself.
+    BaseTextEditorWidget *editorWidget = editor->editorWidget();
+    if (editorWidget->document()->revision() != revision || editorWidget->position() != position)
+        return;
+
+    // Finds the results in the cache this time.
+    editorWidget->invokeAssist(Completion, this);
 }
 
 IAssistProcessor *ClangCompletionAssistProvider::createProcessor() const
@@ -207,28 +742,20 @@ IAssistInterface *ClangCompletionAssistProvider::createAssistInterface(
     Q_UNUSED(project);
 
     QString fileName = editor->document()->filePath();
-    CppModelManagerInterface *modelManager = CppModelManagerInterface::instance();
-    QList<ProjectPart::Ptr> parts = modelManager->projectPart(fileName);
-    if (parts.isEmpty())
-        parts += modelManager->fallbackProjectPart();
     QStringList includePaths, frameworkPaths, options;
     PCHInfo::Ptr pchInfo;
-    foreach (ProjectPart::Ptr part, parts) {
-        if (part.isNull())
-            continue;
-        options = ClangCodeModel::Utils::createClangOptions(part, fileName);
-        pchInfo = PCHManager::instance()->pchInfo(part);
-        if (!pchInfo.isNull())
-            options.append(ClangCodeModel::Utils::createPCHInclusionOptions(pchInfo->fileName()));
-        includePaths = part->includePaths;
-        frameworkPaths = part->frameworkPaths;
-        break;
-    }
+    completionOptions(fileName, &options, &includePaths, &frameworkPaths, &pchInfo);
 
-    return new ClangCodeModel::ClangCompletionAssistInterface(
-                m_clangCompletionWrapper,
+    ClangCompletionAssistInterface *interface = new ClangCompletionAssistInterface(
+                m_unitPool->completer(fileName, options),
                 document, position, fileName, reason,
-                options, includePaths, frameworkPaths, pchInfo);
+                options, includePaths, frameworkPaths, pchInfo,
+                m_resultsCache.data(), m_includePathCache.data(), m_globalCache.data(),
+                completionService());
+    // The provider is only used for scheduling and re-invoking, from the GUI thread.
+    interface->setMemberFastPath(m_fastIndexer,
+                                 const_cast<ClangCompletionAssistProvider *>(this));
+    return interface;
 }
 
 // ------------------------
@@ -242,12 +769,15 @@ public:
         , m_sortable(false)
         , m_completionOperator(T_EOF_SYMBOL)
         , m_replaceDotForArrow(false)
+        , m_isPreliminary(false)
     {}
 
     virtual bool isSortable(const QString &prefix) const;
+    virtual QString detail(int index) const;
     bool m_sortable;
     unsigned m_completionOperator;
     bool m_replaceDotForArrow;
+    bool m_isPreliminary; // Indexed members, until libclang's results are in.
 };
 
 // -------------------
@@ -259,8 +789,10 @@ public:
     ClangAssistProposal(int cursorPos, TextEditor::IGenericProposalModel *model)
         : TextEditor::GenericProposal(cursorPos, model)
         , m_replaceDotForArrow(static_cast<ClangAssistProposalModel *>(model)->m_replaceDotForArrow)
+        , m_isPreliminary(static_cast<ClangAssistProposalModel *>(model)->m_isPreliminary)
     {}
 
+    virtual bool isFragile() const { return m_isPreliminary; }
     virtual bool isCorrective() const { return m_replaceDotForArrow; }
     virtual void makeCorrection(BaseTextEditor *editor)
     {
@@ -271,6 +803,7 @@ public:
 
 private:
     bool m_replaceDotForArrow;
+    bool m_isPreliminary;
 };
 
 // ----------------------
@@ -372,8 +905,15 @@ public:
     bool isCodeCompletionResult() const
     { return data().canConvert<CodeCompletionResult>(); }
 
+    // The hint is only built when the item is shown
+    void setDetailResult(const CodeCompletionResult &ccr)
+    { m_detailResult = ccr; }
+    QString lazyDetail() const
+    { return m_detailResult.isValid() ? m_detailResult.hint() : detail(); }
+
 private:
     unsigned m_completionOperator;
+    CodeCompletionResult m_detailResult;
     mutable QChar m_typedChar;
     QList<CodeCompletionResult> m_overloads;
 };
@@ -385,6 +925,11 @@ bool ClangAssistProposalModel::isSortable(const QString &prefix) const
     return true;
 }
 
+QString ClangAssistProposalModel::detail(int index) const
+{
+    return static_cast<ClangAssistProposalItem *>(proposalItem(index))->lazyDetail();
+}
+
 } // namespace Internal
 } // namespace ClangCodeModel
 
@@ -550,16 +1095,32 @@ ClangCompletionAssistInterface::ClangCompletionAssistInterface(ClangCompleter::P
         const QStringList &options,
         const QStringList &includePaths,
         const QStringList &frameworkPaths,
-        const PCHInfo::Ptr &pchInfo)
+        const PCHInfo::Ptr &pchInfo,
+        CompletionResultsCache *resultsCache,
+        IncludePathCache *includePathCache,
+        GlobalCompletionCache *globalCache,
+        CompletionService *completionService)
     : DefaultAssistInterface(document, position, fileName, reason)
     , m_clangWrapper(clangWrapper)
     , m_options(options)
     , m_includePaths(includePaths)
     , m_frameworkPaths(frameworkPaths)
     , m_savedPchPointer(pchInfo)
+    , m_resultsCache(resultsCache)
+    , m_includePathCache(includePathCache)
+    , m_globalCache(globalCache)
+    , m_completionService(completionService)
+    , m_fastIndexer(0)
+    , m_provider(0)
+    , m_pchFingerprint(globalCache ? GlobalCompletionCache::pchFingerprint(pchInfo) : QByteArray())
+    , m_revision(document->revision())
+    , m_characterCount(document->characterCount())
 {
     Q_ASSERT(!clangWrapper.isNull());
 
+    // Created in the GUI thread, so requests are numbered in the order they were made
+    m_request = clangWrapper->startRequest(m_revision, position);
+
     CppModelManagerInterface *mmi = CppModelManagerInterface::instance();
     Q_ASSERT(mmi);
     m_unsavedFiles = Utils::createUnsavedFiles(mmi->workingCopy());
@@ -594,6 +1155,7 @@ ClangCompletionAssistProcessor::ClangCompletionAssistProcessor()
           << QLatin1String("elif")
           << QLatin1String("else")
           << QLatin1String("endif"))
+    , m_endOfReceiver(-1)
     , m_model(new ClangAssistProposalModel)
     , m_hintProposal(0)
 
@@ -612,6 +1174,8 @@ IAssistProposal *ClangCompletionAssistProcessor::perform(const IAssistInterface
         return 0;
 
     int index = startCompletionHelper();
+    if (m_interface->isSuperseded())
+        return 0;
     if (index != -1) {
         if (m_hintProposal)
             return m_hintProposal;
@@ -701,6 +1265,11 @@ int ClangCompletionAssistProcessor::startCompletionHelper()
         expression = expressionUnderCursor(tc);
         startOfExpression = endOfExpression - expression.length();
 
+        if (m_model->m_completionOperator == T_DOT || m_model->m_completionOperator == T_ARROW) {
+            m_receiver = expression;
+            m_endOfReceiver = endOfExpression;
+        }
+
         if (m_model->m_completionOperator == T_LPAREN) {
             if (expression.endsWith(QLatin1String("SIGNAL")))
                 m_model->m_completionOperator = T_SIGNAL;
@@ -928,7 +1497,47 @@ static int findOpenParen(QTextDocument *doc, int start)
     return -1;
 }
 
-static QByteArray modifyInput(QTextDocument *doc, int endOfExpression) {
+namespace {
+
+// Maps document positions to offsets into the UTF-8 buffer of the same text. Positions are
+// expected in ascending order: the buffer is only scanned on from the previous line, and
+// only the part of the line before the position is converted.
+class Utf8Offsets
+{
+public:
+    Utf8Offsets(QTextDocument *doc, const QByteArray &buffer)
+        : m_doc(doc), m_buffer(buffer), m_blockNumber(0), m_lineOffset(0)
+    {}
+
+    int offset(int position)
+    {
+        const QTextBlock block = m_doc->findBlock(position);
+        if (!block.isValid() || block.blockNumber() < m_blockNumber)
+            return -1;
+
+        for (; m_blockNumber < block.blockNumber(); ++m_blockNumber) {
+            m_lineOffset = m_buffer.indexOf('\n', m_lineOffset);
+            if (m_lineOffset == -1)
+                return -1;
+            ++m_lineOffset;
+        }
+        return m_lineOffset + block.text().left(position - block.position()).toUtf8().size();
+    }
+
+private:
+    QTextDocument *m_doc;
+    const QByteArray &m_buffer;
+    int m_blockNumber;
+    int m_lineOffset;
+};
+
+} // Anonymous
+
+// Turns "connect(pointer, SIGNAL(" into "connect((pointer)->" so clang completes the members
+// of the sender. The modified contents are put together in one pass from the working copy
+// buffer, which is already UTF-8 and stays untouched. Only a document that isn't modified,
+// and so not in the working copy, is converted as a whole.
+static QByteArray modifyInput(QTextDocument *doc, int endOfExpression, const QByteArray &buffer) {
     int comma = endOfExpression;
     while (comma > 0) {
         const QChar ch = doc->characterAt(comma);
@@ -948,12 +1557,24 @@ static QByteArray modifyInput(QTextDocument *doc, int endOfExpression) {
     if (openBrace < 0)
         return QByteArray();
 
-    QByteArray modifiedInput = doc->toPlainText().toUtf8();
-    const int len = endOfExpression - comma;
-    QByteArray replacement(len - 4, ' ');
-    replacement.append(")->");
-    modifiedInput.replace(comma, len, replacement);
-    modifiedInput.insert(openBrace, '(');
+    const QByteArray source = buffer.isEmpty() ? doc->toPlainText().toUtf8() : buffer;
+    Utf8Offsets offsets(doc, source);
+    const int openBraceOffset = offsets.offset(openBrace);
+    const int commaOffset = offsets.offset(comma);
+    const int endOffset = offsets.offset(endOfExpression);
+    if (openBraceOffset < 0 || commaOffset < 0 || endOffset < 0 || endOffset - commaOffset < 4)
+        return QByteArray();
+
+    // "(" goes in before the brace, ", SIGNAL(" becomes ")->" padded with blanks, so the
+    // size and the positions after it stay the same.
+    QByteArray modifiedInput;
+    modifiedInput.reserve(source.size());
+    modifiedInput.append(source.constData(), openBraceOffset);
+    modifiedInput.append('(');
+    modifiedInput.append(source.constData() + openBraceOffset, commaOffset - openBraceOffset);
+    modifiedInput.append(QByteArray(endOffset - commaOffset - 4, ' '));
+    modifiedInput.append(")->");
+    modifiedInput.append(source.constData() + endOffset, source.size() - endOffset);
     return modifiedInput;
 }
 
@@ -968,10 +1589,8 @@ int ClangCompletionAssistProcessor::startCompletionInternal(const QString fileNa
 
     if (m_model->m_completionOperator == T_SIGNAL) {
         signalCompletion = true;
-        modifiedInput = modifyInput(m_interface->textDocument(), endOfExpression);
     } else if (m_model->m_completionOperator == T_SLOT) {
         slotCompletion = true;
-        modifiedInput = modifyInput(m_interface->textDocument(), endOfExpression);
     } else if (m_model->m_completionOperator == T_LPAREN) {
         // Find the expression that precedes the current name
         int index = endOfExpression;
@@ -992,8 +1611,8 @@ int ClangCompletionAssistProcessor::startCompletionInternal(const QString fileNa
 #ifdef DEBUG_TIMING
         qDebug()<<"complete constructor or function @" << line<<":"<<column << "->"<<l<<":"<<c;
 #endif // DEBUG_TIMING
-        const QList<CodeCompletionResult> completions = unfilteredCompletion(
-                    m_interface.data(), fileName, l, c, QByteArray(), signalCompletion || slotCompletion);
+        const QList<CodeCompletionResult> completions = functionOverloads(
+                    m_interface.data(), fileName, l, c, nameStart, functionName);
         QList<CodeCompletionResult> functionCompletions;
         foreach (const CodeCompletionResult &ccr, completions) {
             if (ccr.completionKind() == CodeCompletionResult::FunctionCompletionKind
@@ -1004,6 +1623,7 @@ int ClangCompletionAssistProcessor::startCompletionInternal(const QString fileNa
                 if (ccr.text() == functionName)
                     functionCompletions.append(ccr);
         }
+        qSort(functionCompletions);
 
         if (!functionCompletions.isEmpty()) {
             IFunctionHintProposalModel *model = new ClangFunctionHintModel(functionCompletions);
@@ -1013,9 +1633,43 @@ int ClangCompletionAssistProcessor::startCompletionInternal(const QString fileNa
     }
 
     const QIcon snippetIcon = QIcon(QLatin1String(SNIPPET_ICON_PATH));
-    QList<CodeCompletionResult> completions = unfilteredCompletion(
-                m_interface.data(), fileName, line, column, modifiedInput, signalCompletion || slotCompletion);
-    QHash<QString, ClangAssistProposalItem *> items;
+    const bool isSignalSlot = signalCompletion || slotCompletion;
+    QList<CodeCompletionResult> completions;
+    if (m_model->m_completionOperator != T_LPAREN) {
+        // Typing further narrows the previous results, including the signal/slot ones, so
+        // the sender's members are only looked up once.
+        CompletionResultsCache *cache = m_interface->resultsCache();
+        CompletionResultsCache::Context context = cacheContext(m_interface.data(), fileName,
+                                                               line, column, findStartOfName());
+        context.m_completionOperator = m_model->m_completionOperator;
+        if (!cache || !cache->lookup(context, &completions)) {
+            if (cache && !isSignalSlot && completeMembersFromIndex(fileName, &completions)) {
+                // Shown right away, the libclang results replace them once they are in.
+                m_model->m_isPreliminary = true;
+                m_interface->provider()->startBackgroundCompletion(
+                            new BackgroundCompletionJob(m_interface.data(), line, column, context));
+            } else {
+                if (isSignalSlot) {
+                    modifiedInput = modifyInput(m_interface->textDocument(), endOfExpression,
+                                                m_interface->unsavedFiles().value(fileName));
+                }
+                completions = unfilteredCompletion(m_interface.data(), fileName, line, column,
+                                                   modifiedInput, isSignalSlot);
+                // Results of a superseded request are still good for the next one. No
+                // results may just mean the request was abandoned or timed out.
+                if (cache && !completions.isEmpty())
+                    cache->insert(context, completions);
+            }
+        }
+    } else {
+        completions = unfilteredCompletion(m_interface.data(), fileName, line, column);
+    }
+    if (m_interface->isSuperseded())
+        return -1;
+
+    // Group by name first, so only the overloads of one name get sorted here.
+    // The model sorts the resulting items itself.
+    QHash<QString, QList<CodeCompletionResult> > overloads;
     foreach (const CodeCompletionResult &ccr, completions) {
         if (!ccr.isValid())
             continue;
@@ -1024,25 +1678,33 @@ int ClangCompletionAssistProcessor::startCompletionInternal(const QString fileNa
         if (slotCompletion && ccr.completionKind() != CodeCompletionResult::SlotCompletionKind)
             continue;
 
-        const QString txt(ccr.text());
-        ClangAssistProposalItem *item = items.value(txt, 0);
-        if (item) {
-            item->addOverload(ccr);
-        } else {
-            item = new ClangAssistProposalItem;
-            items.insert(txt, item);
-            item->setText(txt);
-            item->setDetail(ccr.hint());
-            item->setOrder(ccr.priority());
-
-            const QString snippet = ccr.snippet();
-            if (!snippet.isEmpty())
-                item->setData(snippet);
-            else
-                item->setData(qVariantFromValue(ccr));
-        }
+        overloads[ccr.text()].append(ccr);
+    }
+
+    QHash<QString, QList<CodeCompletionResult> >::iterator it = overloads.begin();
+    for (; it != overloads.end(); ++it) {
+        QList<CodeCompletionResult> &group = it.value();
+        if (group.size() > 1)
+            qSort(group);
+
+        const CodeCompletionResult &first = group.first();
+        ClangAssistProposalItem *item = new ClangAssistProposalItem;
+        item->setText(it.key());
+        item->setDetailResult(first);
+        item->setOrder(first.priority());
+
+        const QString snippet = first.snippet();
+        if (!snippet.isEmpty())
+            item->setData(snippet);
+        else
+            item->setData(qVariantFromValue(first));
+
+        for (int i = 1; i < group.size(); ++i)
+            item->addOverload(group.at(i));
+        m_completions.append(item);
 
         // FIXME: show the effective accessebility instead of availability
+        const CodeCompletionResult &ccr = group.last();
         switch (ccr.completionKind()) {
         case CodeCompletionResult::ClassCompletionKind: item->setIcon(m_icons.iconForType(Icons::ClassIconType)); break;
         case CodeCompletionResult::EnumCompletionKind: item->setIcon(m_icons.iconForType(Icons::EnumIconType)); break;
@@ -1107,12 +1769,56 @@ int ClangCompletionAssistProcessor::startCompletionInternal(const QString fileNa
         }
     }
 
-    foreach (ClangAssistProposalItem *item, items.values())
-        m_completions.append(item);
-
     return m_startPosition;
 }
 
+// Member completion from the index, for when libclang would keep the user waiting: the
+// unit is busy or not parsed yet.
+bool ClangCompletionAssistProcessor::completeMembersFromIndex(
+        const QString &fileName, QList<CodeCompletionResult> *completions) const
+{
+    FastIndexer *fastIndexer = m_interface->fastIndexer();
+    if (!fastIndexer || !m_interface->provider() || m_receiver.isEmpty())
+        return false;
+
+    // With the backend, the unit here stays unloaded, only the backend knows whether it
+    // would answer promptly.
+    ClangCompleter::Ptr wrapper = m_interface->clangWrapper();
+    if (CompletionService *service = m_interface->completionService()) {
+        if (service->isReadyFor(fileName))
+            return false;
+    } else if (wrapper->mutex()->tryLock()) {
+        const bool isWarm = wrapper->isLoaded();
+        wrapper->mutex()->unlock();
+        if (isWarm)
+            return false;
+    }
+
+    const QString className = receiverClass(fileName, m_interface->textDocument(), m_receiver,
+                                            m_endOfReceiver, m_model->m_completionOperator);
+    if (className.isEmpty())
+        return false;
+
+    // Overloads are shown as one item anyway. Where the receiver is used isn't known here,
+    // so only what is accessible from anywhere is offered. Operators aren't called by name.
+    QSet<QString> names;
+    foreach (const ClangCodeModel::Symbol &member, fastIndexer->members(className)) {
+        if (member.m_access != ClangCodeModel::Symbol::Public || isOperatorName(member.m_name))
+            continue;
+        if (names.contains(member.m_name))
+            continue;
+        names.insert(member.m_name);
+
+        CodeCompletionResult ccr(INDEXED_MEMBER_PRIORITY);
+        ccr.setText(member.m_name);
+        ccr.setHint(member.m_qualification);
+        ccr.setCompletionKind(CodeCompletionResult::FunctionCompletionKind);
+        ccr.setHasParameters(true);
+        completions->append(ccr);
+    }
+    return !completions->isEmpty();
+}
+
 /**
  * @brief Creates completion proposals for #include and given cursor
  * @param cursor - cursor placed after opening bracked or quote
@@ -1175,29 +1881,45 @@ bool ClangCompletionAssistProcessor::completeInclude(const QTextCursor &cursor)
 void ClangCompletionAssistProcessor::completeIncludePath(const QString &realPath,
                                                          const QStringList &suffixes)
 {
-    QDirIterator i(realPath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    QStringList files, subdirectories;
+    if (IncludePathCache *cache = m_interface->includePathCache()) {
+        cache->entries(realPath, &files, &subdirectories);
+    } else {
+        QDirIterator i(realPath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        while (i.hasNext()) {
+            i.next();
+            if (i.fileInfo().isDir())
+                subdirectories.append(i.fileName());
+            else
+                files.append(i.fileName());
+        }
+    }
+
     const QString hint =
             QObject::tr("Location: ", "Parent folder for proposed #include completion")
             + QDir::cleanPath(realPath);
-    while (i.hasNext()) {
-        const QString fileName = i.next();
-        const QFileInfo fileInfo = i.fileInfo();
-        const QString suffix = fileInfo.suffix();
-        if (suffix.isEmpty() || suffixes.contains(suffix)) {
-            QString text = fileName.mid(realPath.length() + 1);
-            if (fileInfo.isDir())
-                text += QLatin1Char('/');
-
-            ClangAssistProposalItem *item = new ClangAssistProposalItem;
-            item->setText(text);
-            item->setDetail(hint);
-            item->setIcon(m_icons.keywordIcon());
-            item->keepCompletionOperator(m_model->m_completionOperator);
-            m_completions.append(item);
-        }
+    foreach (const QString &subdirectory, subdirectories) {
+        const QString suffix = QFileInfo(subdirectory).suffix();
+        if (suffix.isEmpty() || suffixes.contains(suffix))
+            addIncludeItem(subdirectory + QLatin1Char('/'), hint);
+    }
+    foreach (const QString &file, files) {
+        const QString suffix = QFileInfo(file).suffix();
+        if (suffix.isEmpty() || suffixes.contains(suffix))
+            addIncludeItem(file, hint);
     }
 }
 
+void ClangCompletionAssistProcessor::addIncludeItem(const QString &text, const QString &hint)
+{
+    ClangAssistProposalItem *item = new ClangAssistProposalItem;
+    item->setText(text);
+    item->setDetail(hint);
+    item->setIcon(m_icons.keywordIcon());
+    item->keepCompletionOperator(m_model->m_completionOperator);
+    m_completions.append(item);
+}
+
 void ClangCompletionAssistProcessor::completePreprocessor()
 {
     foreach (const QString &preprocessorCompletion, m_preprocessorCompletions)
@@ -41,26 +41,78 @@
 #include <texteditor/codeassist/defaultassistinterface.h>
 #include <texteditor/codeassist/iassistprocessor.h>
 
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSet>
 #include <QStringList>
 #include <QTextCursor>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace Core { class IEditor; }
+namespace ProjectExplorer { class Project; }
 
 namespace ClangCodeModel {
 
 namespace Internal {
 class ClangAssistProposalModel;
+class CompletionResultsCache;
+class CompletionService;
+class CompletionUnitPool;
+class FastIndexer;
+class GlobalCompletionCache;
+class IncludePathCache;
 
 class ClangCompletionAssistProvider : public CppTools::CppCompletionAssistProvider
 {
+    Q_OBJECT
+
 public:
-    ClangCompletionAssistProvider();
+    explicit ClangCompletionAssistProvider(FastIndexer *fastIndexer = 0);
+    ~ClangCompletionAssistProvider();
 
     virtual TextEditor::IAssistProcessor *createProcessor() const;
     virtual TextEditor::IAssistInterface *createAssistInterface(
             ProjectExplorer::Project *project, TextEditor::BaseTextEditor *editor,
             QTextDocument *document, int position, TextEditor::AssistReason reason) const;
 
+    CompletionUnitPool *unitPool() const;
+
+    // Runs a libclang completion whose results replace the preliminary ones shown meanwhile.
+    void startBackgroundCompletion(QRunnable *job);
+
+public slots:
+    // Parses the file and builds its preamble in the background, so the first completion
+    // in the editor the user switched to hits a warm unit.
+    void warmUp(Core::IEditor *editor);
+
+private slots:
+    void prefetchIncludePaths(ProjectExplorer::Project *project);
+
+    // Reparses the edited files in the background once the user stops typing, so the next
+    // completion or highlighting finds an up-to-date unit.
+    void documentEdited();
+    void reparseEditedFiles();
+
+    // Shows the libclang results, if the user is still waiting at the same place.
+    void backgroundCompletionFinished(const QString &fileName, int revision, int position);
+
 private:
-    ClangCodeModel::ClangCompleter::Ptr m_clangCompletionWrapper;
+    // Null while completing in-process, e.g. without a usable backend.
+    CompletionService *completionService() const;
+
+    QScopedPointer<CompletionUnitPool> m_unitPool;
+    QScopedPointer<CompletionResultsCache> m_resultsCache;
+    QScopedPointer<IncludePathCache> m_includePathCache;
+    QScopedPointer<GlobalCompletionCache> m_globalCache;
+    QScopedPointer<CompletionService> m_completionService;
+    FastIndexer *m_fastIndexer;
+    QThreadPool m_warmUpPool;
+    QThreadPool m_backgroundCompletionPool;
+    QTimer m_idleTimer;
+    QSet<QString> m_editedFiles;
+    QAtomicInt m_editRevision;
 };
 
 } // namespace Internal
@@ -76,11 +128,59 @@ public:
                                    const QStringList &options,
                                    const QStringList &includePaths,
                                    const QStringList &frameworkPaths,
-                                   const Internal::PCHInfo::Ptr &pchInfo);
+                                   const Internal::PCHInfo::Ptr &pchInfo,
+                                   Internal::CompletionResultsCache *resultsCache = 0,
+                                   Internal::IncludePathCache *includePathCache = 0,
+                                   Internal::GlobalCompletionCache *globalCache = 0,
+                                   Internal::CompletionService *completionService = 0);
 
     ClangCodeModel::ClangCompleter::Ptr clangWrapper() const
     { return m_clangWrapper; }
 
+    Internal::CompletionResultsCache *resultsCache() const
+    { return m_resultsCache; }
+
+    Internal::IncludePathCache *includePathCache() const
+    { return m_includePathCache; }
+
+    Internal::GlobalCompletionCache *globalCache() const
+    { return m_globalCache; }
+
+    const QByteArray &pchFingerprint() const
+    { return m_pchFingerprint; }
+
+    // Null when completing in-process.
+    Internal::CompletionService *completionService() const
+    { return m_completionService; }
+
+    const Internal::PCHInfo::Ptr &pchInfo() const
+    { return m_savedPchPointer; }
+
+    // For showing indexed members right away while libclang is busy, may be null.
+    void setMemberFastPath(Internal::FastIndexer *fastIndexer,
+                           Internal::ClangCompletionAssistProvider *provider)
+    { m_fastIndexer = fastIndexer; m_provider = provider; }
+
+    Internal::FastIndexer *fastIndexer() const
+    { return m_fastIndexer; }
+
+    Internal::ClangCompletionAssistProvider *provider() const
+    { return m_provider; }
+
+    // Taken from the editor's document, not from the copy a processor might work on.
+    int revision() const
+    { return m_revision; }
+
+    int characterCount() const
+    { return m_characterCount; }
+
+    // True once the user asked for completion at another revision or position
+    bool isSuperseded() const
+    { return m_clangWrapper->isSuperseded(m_request); }
+
+    quint64 request() const
+    { return m_request; }
+
     const ClangCodeModel::Internal::UnsavedFiles &unsavedFiles() const
     { return m_unsavedFiles; }
 
@@ -100,6 +200,16 @@ private:
     ClangCodeModel::Internal::UnsavedFiles m_unsavedFiles;
     QStringList m_options, m_includePaths, m_frameworkPaths;
     Internal::PCHInfo::Ptr m_savedPchPointer;
+    Internal::CompletionResultsCache *m_resultsCache;
+    Internal::IncludePathCache *m_includePathCache;
+    Internal::GlobalCompletionCache *m_globalCache;
+    Internal::CompletionService *m_completionService;
+    Internal::FastIndexer *m_fastIndexer;
+    Internal::ClangCompletionAssistProvider *m_provider;
+    QByteArray m_pchFingerprint;
+    int m_revision;
+    int m_characterCount;
+    quint64 m_request;
 };
 
 class CLANG_EXPORT ClangCompletionAssistProcessor : public TextEditor::IAssistProcessor
@@ -120,9 +230,12 @@ private:
     int startCompletionInternal(const QString fileName,
                                 unsigned line, unsigned column,
                                 int endOfExpression);
+    bool completeMembersFromIndex(const QString &fileName,
+                                  QList<CodeCompletionResult> *completions) const;
 
     bool completeInclude(const QTextCursor &cursor);
     void completeIncludePath(const QString &realPath, const QStringList &suffixes);
+    void addIncludeItem(const QString &text, const QString &hint);
     void completePreprocessor();
     void addCompletionItem(const QString &text,
                            const QIcon &icon = QIcon(),
@@ -131,6 +244,8 @@ private:
 
 private:
     int m_startPosition;
+    int m_endOfReceiver;
+    QString m_receiver;
     QScopedPointer<const ClangCompletionAssistInterface> m_interface;
     QList<TextEditor::BasicProposalItem *> m_completions;
     CPlusPlus::Icons m_icons;
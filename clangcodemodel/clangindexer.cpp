@@ -161,6 +161,21 @@ void ClangIndexer::indexNow(const ClangCodeModel::Internal::Unit &unit)
         m_clangIndexer->runQuickIndexing(unit, part);
 }
 
+QList<Symbol> ClangIndexer::derivedClasses(const QString &qualifiedClassName) const
+{
+    return m_clangIndexer->derivedClasses(qualifiedClassName);
+}
+
+QList<Symbol> ClangIndexer::members(const QString &qualifiedClassName) const
+{
+    return m_clangIndexer->members(qualifiedClassName);
+}
+
+IndexerMetrics *ClangIndexer::metrics() const
+{
+    return m_clangIndexer->metrics();
+}
+
 void ClangIndexer::onIndexingStarted(QFuture<void> indexingFuture)
 {
     Core::ICore::instance()->progressManager()->addTask(indexingFuture,
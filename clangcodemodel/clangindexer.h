@@ -35,15 +35,18 @@
 #include <cpptools/cppindexingsupport.h>
 
 #include <QObject>
+#include <QList>
 
 namespace ClangCodeModel {
 
 class Indexer;
+class Symbol;
 
 namespace Internal {
 
 class ClangIndexer;
 class ClangSymbolSearcher;
+class IndexerMetrics;
 
 class ClangIndexingSupport: public CppTools::CppIndexingSupport
 {
@@ -72,7 +75,12 @@ public:
 
     void match(ClangSymbolSearcher *searcher) const;
 
+    QList<Symbol> derivedClasses(const QString &qualifiedClassName) const;
+
     void indexNow(const Unit &unit);
+    QList<Symbol> members(const QString &qualifiedClassName) const;
+
+    IndexerMetrics *metrics() const;
 
 public slots:
     void onAboutToLoadSession(const QString &sessionName);
@@ -8,7 +8,7 @@ using namespace ClangCodeModel;
 using namespace ClangCodeModel::Internal;
 
 ModelManagerSupport::ModelManagerSupport(FastIndexer *fastIndexer)
-    : m_completionAssistProvider(new ClangCompletionAssistProvider)
+    : m_completionAssistProvider(new ClangCompletionAssistProvider(fastIndexer))
     , m_fastIndexer(fastIndexer)
 {
 }
@@ -30,10 +30,12 @@
 #include "clangprojectsettings.h"
 #include "clangprojectsettingspropertiespage.h"
 #include "pchmanager.h"
+#include "sharedunits.h"
 
 #include <QButtonGroup>
 #include <QCoreApplication>
 #include <QFileDialog>
+#include <QTimer>
 
 using namespace ProjectExplorer;
 using namespace ClangCodeModel::Internal;
@@ -76,9 +78,14 @@ PropertiesPanel *ClangProjectSettingsPanelFactory::createPanel(Project *project)
 
 ClangProjectSettingsWidget::ClangProjectSettingsWidget(Project *project)
     : m_project(project)
+    , m_memoryTimer(new QTimer(this))
 {
     m_ui.setupUi(this);
 
+    // The units are shared by all projects, this only shows what the code model holds.
+    m_memoryTimer->setInterval(2000);
+    connect(m_memoryTimer, SIGNAL(timeout()), this, SLOT(updateMemoryUsage()));
+
     ClangProjectSettings *cps = PCHManager::instance()->settingsForProject(project);
     Q_ASSERT(cps);
 
@@ -163,3 +170,33 @@ void ClangProjectSettingsWidget::customPchButtonClicked()
     m_ui.customField->setText(fileNames.first());
     cps->setCustomPchFile(fileNames.first());
 }
+
+void ClangProjectSettingsWidget::updateMemoryUsage()
+{
+    SharedUnits *sharedUnits = SharedUnits::instance();
+    if (!sharedUnits) {
+        m_ui.memoryLabel->clear();
+        return;
+    }
+
+    const qint64 usageMB = sharedUnits->memoryUsage() / (1024 * 1024);
+    const qint64 budgetMB = sharedUnits->memoryBudget() / (1024 * 1024);
+    QString text = budgetMB > 0 ? tr("%1 of %2 MiB loaded").arg(usageMB).arg(budgetMB)
+                                : tr("%1 MiB loaded").arg(usageMB);
+    text += QLatin1String(", ") + tr("%n released", 0, sharedUnits->releasedUnits());
+    m_ui.memoryLabel->setText(text);
+    m_ui.memoryLabel->setToolTip(sharedUnits->memoryReport());
+}
+
+void ClangProjectSettingsWidget::showEvent(QShowEvent *event)
+{
+    updateMemoryUsage();
+    m_memoryTimer->start();
+    QWidget::showEvent(event);
+}
+
+void ClangProjectSettingsWidget::hideEvent(QHideEvent *event)
+{
+    m_memoryTimer->stop();
+    QWidget::hideEvent(event);
+}
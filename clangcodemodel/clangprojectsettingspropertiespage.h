@@ -36,6 +36,8 @@
 
 #include <QString>
 
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
 namespace ClangCodeModel {
 namespace Internal {
 
@@ -60,10 +62,16 @@ protected slots:
     void pchUsageChanged(int id);
     void customPchFileChanged();
     void customPchButtonClicked();
+    void updateMemoryUsage();
+
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
 
 private:
     Ui::ClangProjectSettingsPropertiesPage m_ui;
     ProjectExplorer::Project *m_project;
+    QTimer *m_memoryTimer;
 };
 
 } // ClangCodeModel namespace
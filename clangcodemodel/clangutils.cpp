@@ -28,6 +28,7 @@
 ****************************************************************************/
 
 #include "clangutils.h"
+#include "unsavedfilesstore.h"
 
 #include <clang-c/Index.h>
 
@@ -70,6 +71,9 @@ UnsavedFiles createUnsavedFiles(CppModelManagerInterface::WorkingCopy workingCop
     foreach (IDocument *doc, Core::DocumentManager::modifiedDocuments())
         modifiedFiles.insert(doc->filePath());
 
+    if (UnsavedFilesStore *store = UnsavedFilesStore::instance())
+        return store->update(workingCopy, modifiedFiles);
+
     UnsavedFiles result;
     QHashIterator<QString, QPair<QByteArray, unsigned> > wcIter = workingCopy.iterator();
     while (wcIter.hasNext()) {
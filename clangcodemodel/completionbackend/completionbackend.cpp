@@ -0,0 +1,198 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "completionbackend.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QHash>
+#include <QtCore/QMutexLocker>
+
+#include <cstdio>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+QByteArray readExactly(QFile *input, qint64 size)
+{
+    QByteArray data;
+    while (data.size() < size) {
+        const QByteArray chunk = input->read(size - data.size());
+        if (chunk.isEmpty())
+            break;
+        data.append(chunk);
+    }
+    return data;
+}
+
+} // Anonymous
+
+RequestReader::RequestReader()
+    : m_atEnd(false)
+{
+}
+
+QList<CompletionServiceRequest> RequestReader::takeRequests()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_requests.isEmpty() && !m_atEnd)
+        m_arrived.wait(&m_mutex);
+
+    QList<CompletionServiceRequest> requests = m_requests;
+    m_requests.clear();
+    return requests;
+}
+
+void RequestReader::run()
+{
+    QFile input;
+    if (input.open(stdin, QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        const int sizeLength = sizeof(quint32);
+        forever {
+            QByteArray buffer = readExactly(&input, sizeLength);
+            if (buffer.size() != sizeLength)
+                break;
+            quint32 size;
+            QDataStream(buffer) >> size;
+            buffer.append(readExactly(&input, size));
+
+            QByteArray payload;
+            CompletionServiceRequest request;
+            if (!takeMessage(&buffer, &payload) || !decodeMessage(payload, &request))
+                break;
+
+            QMutexLocker locker(&m_mutex);
+            m_requests.append(request);
+            m_arrived.wakeAll();
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_atEnd = true;
+    m_arrived.wakeAll();
+}
+
+CompletionBackend::CompletionBackend(GlobalCompletionCache *globalCache)
+    : m_globalCache(globalCache)
+{
+}
+
+CompletionBackend::~CompletionBackend()
+{
+}
+
+int CompletionBackend::exec()
+{
+    if (!m_output.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered))
+        return 1;
+
+    m_reader.start();
+    forever {
+        QList<CompletionServiceRequest> requests = m_reader.takeRequests();
+        if (requests.isEmpty())
+            break;
+
+        // In order, each request builds on the buffers of the previous ones.
+        for (int i = 0; i < requests.size(); ++i)
+            restoreUnsavedFiles(&requests[i]);
+
+        // Requests piled up while the previous one was served. Per file, only the newest
+        // one is still of interest, the older ones get their empty answer right away.
+        QHash<QString, int> newest;
+        for (int i = 0; i < requests.size(); ++i) {
+            if (!requests.at(i).isParseOnly())
+                newest.insert(requests.at(i).m_fileName, i);
+        }
+
+        for (int i = 0; i < requests.size(); ++i) {
+            const CompletionServiceRequest &request = requests.at(i);
+            if (!request.isParseOnly() && newest.value(request.m_fileName) != i)
+                respond(request.m_id, QList<CodeCompletionResult>());
+            else
+                serve(request);
+        }
+    }
+
+    m_reader.wait();
+    return 0;
+}
+
+// Puts back the buffers the service left out of the request, as the backend has them, and
+// keeps the ones it sent along.
+void CompletionBackend::restoreUnsavedFiles(CompletionServiceRequest *request)
+{
+    QHash<QString, QPair<quint32, QByteArray> > unsavedFiles;
+
+    QHashIterator<QString, quint32> it(request->m_unsavedRevisions);
+    while (it.hasNext()) {
+        it.next();
+        QPair<quint32, QByteArray> buffer(it.value(), QByteArray());
+        if (request->m_unsavedFiles.contains(it.key())) {
+            buffer.second = request->m_unsavedFiles.value(it.key());
+        } else if (m_unsavedFiles.value(it.key()).first == it.value()) {
+            buffer.second = m_unsavedFiles.value(it.key()).second;
+            request->m_unsavedFiles.insert(it.key(), buffer.second);
+        } else {
+            qWarning("Unsaved contents of %s missing, completing on the file as saved.",
+                     qPrintable(it.key()));
+            continue;
+        }
+        unsavedFiles.insert(it.key(), buffer);
+    }
+
+    m_unsavedFiles = unsavedFiles;
+}
+
+void CompletionBackend::serve(const CompletionServiceRequest &request)
+{
+    ClangCompleter::Ptr completer = m_units.completer(request.m_fileName, request.m_options);
+    QMutexLocker lock(completer->mutex());
+
+    if (request.isParseOnly()) {
+        // The initial parse doesn't build the precompiled preamble, the first reparse does.
+        if (completer->reparse(request.m_unsavedFiles))
+            completer->warmUp(request.m_unsavedFiles);
+        return;
+    }
+
+    completer->setSignalSlotCompletion(request.m_isSignalSlotCompletion);
+    completer->setGlobalCompletionCache(m_globalCache, request.m_pchFingerprint);
+    respond(request.m_id, completer->codeCompleteAt(request.m_line, request.m_column,
+                                                    request.m_unsavedFiles));
+}
+
+void CompletionBackend::respond(quint32 id, const QList<CodeCompletionResult> &results)
+{
+    CompletionServiceResponse response;
+    response.m_id = id;
+    response.m_results = results;
+    m_output.write(encodeMessage(response));
+    m_output.flush();
+}
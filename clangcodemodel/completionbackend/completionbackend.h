@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef COMPLETIONBACKEND_H
+#define COMPLETIONBACKEND_H
+
+#include "../completionserviceprotocol.h"
+#include "../completionunitpool.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+class GlobalCompletionCache;
+
+// Reads the requests from the standard input as they come, while the backend is busy.
+class RequestReader : public QThread
+{
+public:
+    RequestReader();
+
+    // Blocks until there are requests. None once the input is closed.
+    QList<CompletionServiceRequest> takeRequests();
+
+protected:
+    void run();
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_arrived;
+    QList<CompletionServiceRequest> m_requests;
+    bool m_atEnd;
+};
+
+/*
+ * The backend process of the CompletionService: keeps the completion units of the most
+ * recently completed files and answers the requests one after the other, through the
+ * standard output.
+ */
+class CompletionBackend
+{
+    Q_DISABLE_COPY(CompletionBackend)
+
+public:
+    explicit CompletionBackend(GlobalCompletionCache *globalCache);
+    ~CompletionBackend();
+
+    // Serves requests until the plugin closes the input.
+    int exec();
+
+private:
+    void restoreUnsavedFiles(CompletionServiceRequest *request);
+    void serve(const CompletionServiceRequest &request);
+    void respond(quint32 id, const QList<CodeCompletionResult> &results);
+
+    RequestReader m_reader;
+    QFile m_output;
+    CompletionUnitPool m_units;
+    GlobalCompletionCache *m_globalCache;
+    QHash<QString, QPair<quint32, QByteArray> > m_unsavedFiles; // Revision and contents
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // COMPLETIONBACKEND_H
@@ -0,0 +1,44 @@
+include(../../../../qtcreator.pri)
+include(../clang_installation.pri)
+
+TEMPLATE = app
+TARGET = clangcompletionbackend
+DESTDIR = $$IDE_BIN_PATH
+
+CONFIG += console
+CONFIG -= app_bundle
+
+# Next to the Qt Creator binary, where CompletionService::defaultBackendPath() looks
+target.path = $$INSTALL_BIN_PATH
+INSTALLS += target
+
+LIBS += $$LLVM_LIBS -L$$IDE_LIBRARY_PATH -l$$qtLibraryName(Utils)
+INCLUDEPATH += $$LLVM_INCLUDEPATH $$IDE_SOURCE_TREE/src/libs
+DEFINES += CLANGCODEMODEL_LIBRARY
+
+unix:QMAKE_LFLAGS += -Wl,-rpath,\'$$LLVM_LIBDIR\'
+linux-*:QMAKE_LFLAGS += -Wl,-rpath,\'\$\$ORIGIN/../$$IDE_LIBRARY_BASENAME/qtcreator\'
+
+# The libclang-only part of the plugin
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/completionbackend.cpp \
+    $$PWD/../clangcompleter.cpp \
+    $$PWD/../completionproposalsbuilder.cpp \
+    $$PWD/../completionserviceprotocol.cpp \
+    $$PWD/../completionunitpool.cpp \
+    $$PWD/../diagnostic.cpp \
+    $$PWD/../globalcompletioncache.cpp \
+    $$PWD/../pchinfo.cpp \
+    $$PWD/../raii/scopedclangoptions.cpp \
+    $$PWD/../sharedclangindex.cpp \
+    $$PWD/../sharedunits.cpp \
+    $$PWD/../sourcelocation.cpp \
+    $$PWD/../sourcemarker.cpp \
+    $$PWD/../unit.cpp \
+    $$PWD/../unsavedfiledata.cpp \
+    $$PWD/../utils.cpp \
+    $$PWD/../utils_p.cpp
+
+HEADERS += \
+    $$PWD/completionbackend.h
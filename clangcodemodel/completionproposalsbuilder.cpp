@@ -32,6 +32,7 @@
 
 #include <QTextDocument>
 #include <QCoreApplication>
+#include <QMutexLocker>
 
 enum PriorityFixes {
     PriorityFix_ExplicitDestructorCall = 10
@@ -61,6 +62,56 @@ struct ObjCMessagePart {
 };
 } // anonymous namespace
 
+CompletionHintSource::CompletionHintSource(CXCodeCompleteResults *results, quint64 contexts,
+                                           bool isSignalSlotCompletion)
+    : m_results(results)
+    , m_contexts(contexts)
+    , m_isSignalSlotCompletion(isSignalSlotCompletion)
+{
+}
+
+CompletionHintSource::~CompletionHintSource()
+{
+    clang_disposeCodeCompleteResults(m_results);
+}
+
+/**
+ * @return True if \a cxResult belongs to these results, its position is stored in \a index
+ */
+bool CompletionHintSource::indexOf(const CXCompletionResult &cxResult, unsigned *index) const
+{
+    const CXCompletionResult *first = m_results->Results;
+    if (&cxResult < first || &cxResult >= first + m_results->NumResults)
+        return false;
+    *index = static_cast<unsigned>(&cxResult - first);
+    return true;
+}
+
+/**
+ * @brief Builds the hint of one proposal
+ *
+ * Runs the eager builder on the single libclang result and remembers the hints of
+ * all its optional chunk variants, since they are usually shown together.
+ */
+QString CompletionHintSource::hint(unsigned index, int variant)
+{
+    const quint64 key = (quint64(index) << 32) | quint32(variant);
+    QMutexLocker lock(&m_mutex);
+    QHash<quint64, QString>::const_iterator it = m_hints.constFind(key);
+    if (it != m_hints.constEnd())
+        return it.value();
+
+    if (index >= size())
+        return QString();
+
+    QList<CodeCompletionResult> results;
+    CompletionProposalsBuilder builder(results, m_contexts, m_isSignalSlotCompletion);
+    builder(completionAt(index));
+    for (int i = 0; i < results.size(); ++i)
+        m_hints.insert((quint64(index) << 32) | quint32(i), results.at(i).hint());
+    return m_hints.value(key);
+}
+
 /**
  * @class ClangCodeModel::CompletionProposalsBuilder
  * @brief Captures completion lists and than processes sequence of completion chunks
@@ -69,6 +120,10 @@ struct ObjCMessagePart {
  * only if result contains chunks with kind 'Optional'
  * Different proposals can have the same text, it's normal behavior.
  *
+ * With a CompletionHintSource, results that need no snippet only get their text,
+ * kind and parameters here. Their hints (signature, brief comment) are built by
+ * the source when a proposal is actually shown.
+ *
  * @note Unit tests are in \a clangcompletion_test.cpp
  *
  * @note Unresolved problems:
@@ -77,16 +132,20 @@ struct ObjCMessagePart {
  *
  */
 
-CompletionProposalsBuilder::CompletionProposalsBuilder(QList<CodeCompletionResult> &results, quint64 contexts, bool isSignalSlotCompletion)
+CompletionProposalsBuilder::CompletionProposalsBuilder(QList<CodeCompletionResult> &results, quint64 contexts, bool isSignalSlotCompletion,
+                                                       const QSharedPointer<CompletionHintSource> &hintSource)
     : m_results(results)
     , m_contexts(contexts)
     , m_isSignalSlotCompletion(isSignalSlotCompletion)
+    , m_hintSource(hintSource)
 {
 }
 
 void CompletionProposalsBuilder::operator ()(const CXCompletionResult &cxResult)
 {
     resetWithResult(cxResult);
+    if (m_hintSource && buildWithLazyHint(cxResult))
+        return;
 
 #if defined(CINDEX_VERSION) && (CINDEX_VERSION > 5)
     const QString brief = Internal::getQString(clang_getCompletionBriefComment(cxResult.CompletionString));
@@ -325,6 +384,122 @@ void CompletionProposalsBuilder::resetWithResult(const CXCompletionResult &cxRes
     m_snippet.clear();
     m_comment.clear();
     m_optionalChunks.clear();
+    m_hasLazyHint = false;
+    m_hintIndex = 0;
+    m_hintVariant = 0;
+}
+
+/**
+ * @brief Appends proposals whose hints are built later by the hint source
+ * @return False if the result needs a snippet or a special text, then it's built eagerly
+ */
+bool CompletionProposalsBuilder::buildWithLazyHint(const CXCompletionResult &cxResult)
+{
+    if (!m_hintSource->indexOf(cxResult, &m_hintIndex))
+        return false;
+
+    int optionalChunks = 0;
+    switch (m_resultKind) {
+    case CodeCompletionResult::ObjCMessageCompletionKind:
+    case CodeCompletionResult::ClangSnippetKind:
+        return false;
+    case CodeCompletionResult::ClassCompletionKind:
+    case CodeCompletionResult::NamespaceCompletionKind:
+    case CodeCompletionResult::EnumeratorCompletionKind:
+        if (!scanChunksForNestedName(cxResult.CompletionString))
+            return false;
+        break;
+    case CodeCompletionResult::SlotCompletionKind:
+    case CodeCompletionResult::SignalCompletionKind:
+        if (m_isSignalSlotCompletion)
+            return false;
+        // fall-through
+    default:
+        if (!scanChunksOnlyTypedText(cxResult.CompletionString, &optionalChunks))
+            return false;
+        break;
+    }
+
+    // Same proposals as the eager path: one, plus one per optional chunk
+    m_hasLazyHint = true;
+    for (m_hintVariant = 0; m_hintVariant <= optionalChunks; ++m_hintVariant)
+        finalize();
+    return true;
+}
+
+/**
+ * @brief Collects the text of \a concatChunksForNestedName() without hint
+ * @return False for templates, which get a snippet
+ */
+bool CompletionProposalsBuilder::scanChunksForNestedName(const CXCompletionString &cxString)
+{
+    unsigned count = clang_getNumCompletionChunks(cxString);
+    for (unsigned i = 0; i < count; ++i) {
+        switch (clang_getCompletionChunkKind(cxString, i)) {
+        case CXCompletionChunk_TypedText:
+        case CXCompletionChunk_Text:
+            m_text += Internal::getQString(clang_getCompletionChunkText(cxString, i), false);
+            break;
+        case CXCompletionChunk_Placeholder:
+            return false;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Collects the text and parameters of \a concatChunksOnlyTypedText() without hint
+ * @return False for template specializations, which get a snippet
+ */
+bool CompletionProposalsBuilder::scanChunksOnlyTypedText(const CXCompletionString &cxString,
+                                                         int *optionalChunks)
+{
+    bool previousChunkWasLParen = false;
+
+    unsigned count = clang_getNumCompletionChunks(cxString);
+    for (unsigned i = 0; i < count; ++i) {
+        CXCompletionChunkKind chunkKind = clang_getCompletionChunkKind(cxString, i);
+
+        switch (chunkKind) {
+        case CXCompletionChunk_LeftAngle:
+            return false;
+        case CXCompletionChunk_TypedText:
+            m_text = Internal::getQString(clang_getCompletionChunkText(cxString, i), false);
+            break;
+        case CXCompletionChunk_Optional:
+            *optionalChunks += countOptionalChunks(
+                        clang_getCompletionChunkCompletionString(cxString, i));
+            break;
+        default:
+            break;
+        }
+
+        if (chunkKind == CXCompletionChunk_RightParen && previousChunkWasLParen)
+            m_hasParameters = false;
+
+        if (chunkKind == CXCompletionChunk_LeftParen) {
+            previousChunkWasLParen = true;
+            m_hasParameters = true;
+        } else {
+            previousChunkWasLParen = false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @return Number of proposal variants \a appendOptionalChunks() adds for \a cxString
+ */
+int CompletionProposalsBuilder::countOptionalChunks(const CXCompletionString &cxString)
+{
+    unsigned count = clang_getNumCompletionChunks(cxString);
+    for (unsigned i = 0; i < count; ++i) {
+        if (clang_getCompletionChunkKind(cxString, i) == CXCompletionChunk_Optional)
+            return 1 + countOptionalChunks(clang_getCompletionChunkCompletionString(cxString, i));
+    }
+    return 1;
 }
 
 /**
@@ -347,7 +522,10 @@ void CompletionProposalsBuilder::finalize()
     ccr.setCompletionKind(m_resultKind);
     ccr.setAvailability(m_resultAvailability);
     ccr.setHasParameters(m_hasParameters);
-    ccr.setHint(m_hint);
+    if (m_hasLazyHint)
+        ccr.setHintSource(m_hintSource, m_hintIndex, m_hintVariant);
+    else
+        ccr.setHint(m_hint);
     ccr.setText(m_text);
     ccr.setSnippet(m_snippet);
     m_results.append(ccr);
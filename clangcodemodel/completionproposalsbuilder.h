@@ -34,12 +34,47 @@
 #include "clang_global.h"
 #include <clang-c/Index.h>
 
+#include <QHash>
+#include <QMutex>
+
 namespace ClangCodeModel {
 
+/**
+ * @brief Owns the libclang completion results and builds proposal hints on demand
+ *
+ * Shared by all CodeCompletionResult values of one completion request.
+ */
+class CLANG_EXPORT CompletionHintSource
+{
+    Q_DISABLE_COPY(CompletionHintSource)
+
+public:
+    CompletionHintSource(CXCodeCompleteResults *results, quint64 contexts,
+                         bool isSignalSlotCompletion);
+    ~CompletionHintSource();
+
+    unsigned size() const
+    { return m_results->NumResults; }
+    const CXCompletionResult &completionAt(unsigned index) const
+    { return m_results->Results[index]; }
+    bool indexOf(const CXCompletionResult &cxResult, unsigned *index) const;
+
+    QString hint(unsigned index, int variant);
+
+private:
+    CXCodeCompleteResults *m_results;
+    const quint64 m_contexts;
+    const bool m_isSignalSlotCompletion;
+
+    QMutex m_mutex;
+    QHash<quint64, QString> m_hints;
+};
+
 class CLANG_EXPORT CompletionProposalsBuilder
 {
 public:
-    CompletionProposalsBuilder(QList<CodeCompletionResult> &results, quint64 contexts, bool isSignalSlotCompletion);
+    CompletionProposalsBuilder(QList<CodeCompletionResult> &results, quint64 contexts, bool isSignalSlotCompletion,
+                               const QSharedPointer<CompletionHintSource> &hintSource = QSharedPointer<CompletionHintSource>());
     void operator ()(const CXCompletionResult &cxResult);
 
 private:
@@ -53,9 +88,14 @@ private:
     static CodeCompletionResult::Kind getKind(const CXCompletionResult &cxResult);
     static CodeCompletionResult::Availability getAvailability(const CXCompletionResult &cxResult);
     static int findNameInPlaceholder(const QString &text);
+    static int countOptionalChunks(const CXCompletionString &cxString);
     void resetWithResult(const CXCompletionResult &cxResult);
     void finalize();
 
+    bool buildWithLazyHint(const CXCompletionResult &cxResult);
+    bool scanChunksForNestedName(const CXCompletionString &cxString);
+    bool scanChunksOnlyTypedText(const CXCompletionString &cxString, int *optionalChunks);
+
     void concatChunksForObjectiveCMessage(const CXCompletionResult &cxResult);
     void concatChunksForNestedName(const CXCompletionString &cxString);
     void concatChunksAsSnippet(const CXCompletionString &cxString);
@@ -71,6 +111,7 @@ private:
     QList<CodeCompletionResult> &m_results;
     const quint64 m_contexts;
     const bool m_isSignalSlotCompletion;
+    const QSharedPointer<CompletionHintSource> m_hintSource;
 
     unsigned m_priority;
     CodeCompletionResult::Kind m_resultKind;
@@ -81,6 +122,9 @@ private:
     QString m_snippet;
     QString m_comment;
     QList<OptionalChunk> m_optionalChunks;
+    bool m_hasLazyHint;
+    unsigned m_hintIndex;
+    int m_hintVariant;
 };
 
 } // namespace ClangCodeModel
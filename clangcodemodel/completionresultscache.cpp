@@ -0,0 +1,136 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "completionresultscache.h"
+
+#include <QtCore/QMutexLocker>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+CompletionResultsCache::CompletionResultsCache()
+    : m_isValid(false)
+{
+}
+
+bool CompletionResultsCache::lookup(const Context &context, QList<CodeCompletionResult> *results)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_isValid || !isExtensionOf(m_context, context))
+        return false;
+
+    if (context.m_prefix.size() > m_context.m_prefix.size()) {
+        // Filtering keeps the order, the results are already sorted.
+        QList<CodeCompletionResult> narrowed;
+        foreach (const CodeCompletionResult &ccr, m_results) {
+            if (mayMatch(ccr.text(), context.m_prefix))
+                narrowed.append(ccr);
+        }
+        m_results = narrowed;
+    }
+
+    m_context = context;
+    *results = m_results;
+    return true;
+}
+
+bool CompletionResultsCache::peek(const Context &context,
+                                  QList<CodeCompletionResult> *results) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_isValid)
+        return false;
+
+    // Whatever operator led to the results, they are only searched for the function name.
+    Context anyOperator = context;
+    anyOperator.m_completionOperator = m_context.m_completionOperator;
+    if (!isExtensionOf(m_context, anyOperator))
+        return false;
+
+    *results = m_results;
+    return true;
+}
+
+void CompletionResultsCache::insert(const Context &context,
+                                    const QList<CodeCompletionResult> &results)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_isValid = true;
+    m_context = context;
+    m_results = results;
+}
+
+void CompletionResultsCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_isValid = false;
+    m_results.clear();
+}
+
+bool CompletionResultsCache::isExtensionOf(const Context &cached, const Context &context)
+{
+    if (context.m_fileName != cached.m_fileName
+            || context.m_line != cached.m_line
+            || context.m_column != cached.m_column
+            || context.m_completionOperator != cached.m_completionOperator
+            || context.m_options != cached.m_options
+            || !context.m_prefix.startsWith(cached.m_prefix)) {
+        return false;
+    }
+
+    // Anything else edited in the meantime shows up as extra characters or revisions.
+    const int growth = context.m_prefix.size() - cached.m_prefix.size();
+    const int revisions = context.m_revision - cached.m_revision;
+    return context.m_characterCount - cached.m_characterCount == growth
+            && revisions >= 0 && revisions <= growth;
+}
+
+bool CompletionResultsCache::mayMatch(const QString &text, const QString &prefix)
+{
+    // Must keep everything the proposal's own filter could show, including camel case
+    // matches: the first character matches and the rest is a subsequence, ignoring case.
+    if (prefix.isEmpty())
+        return true;
+    if (text.isEmpty() || text.at(0).toLower() != prefix.at(0).toLower())
+        return false;
+
+    int t = 1;
+    for (int p = 1; p < prefix.size(); ++p, ++t) {
+        const QChar c = prefix.at(p).toLower();
+        while (t < text.size() && text.at(t).toLower() != c)
+            ++t;
+        if (t == text.size())
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef COMPLETIONRESULTSCACHE_H
+#define COMPLETIONRESULTSCACHE_H
+
+#include "clangcompleter.h"
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * Remembers the raw results of the last completion, so that typing more of the same name
+ * narrows them down instead of asking libclang again.
+ *
+ * Results are computed at the start of the name being completed, so they only depend on
+ * what precedes it. They are reused as long as the only edits since the query are
+ * characters appended to the name: same file and start position, the typed prefix extends
+ * the cached one, and both the document revision and size grew by no more than the prefix.
+ */
+class CompletionResultsCache
+{
+    Q_DISABLE_COPY(CompletionResultsCache)
+
+public:
+    struct Context
+    {
+        Context()
+            : m_line(0), m_column(0), m_completionOperator(0), m_revision(0)
+            , m_characterCount(0)
+        {}
+
+        QString m_fileName;
+        QStringList m_options;
+        unsigned m_line;
+        unsigned m_column;
+        unsigned m_completionOperator; // Signal/slot results differ from member ones.
+        int m_revision;
+        int m_characterCount;
+        QString m_prefix;
+    };
+
+    CompletionResultsCache();
+
+    // On success, the results are narrowed to the ones which can still match the prefix,
+    // and the cache moves on to the given context.
+    bool lookup(const Context &context, QList<CodeCompletionResult> *results);
+    // Same check, but hands out the results as they are and leaves the cache alone. Used by
+    // function hints, where the "prefix" runs past the name into the argument list.
+    bool peek(const Context &context, QList<CodeCompletionResult> *results) const;
+    void insert(const Context &context, const QList<CodeCompletionResult> &results);
+    void clear();
+
+private:
+    static bool isExtensionOf(const Context &cached, const Context &context);
+    static bool mayMatch(const QString &text, const QString &prefix);
+
+    mutable QMutex m_mutex;
+    bool m_isValid;
+    Context m_context;
+    QList<CodeCompletionResult> m_results;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // COMPLETIONRESULTSCACHE_H
@@ -0,0 +1,308 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "completionservice.h"
+
+#include <utils/hostosinfo.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDebug>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+CompletionService::CompletionService(const QString &backendPath,
+                                     const QStringList &arguments,
+                                     QObject *parent)
+    : QObject(parent)
+    , m_backendPath(backendPath)
+    , m_arguments(arguments)
+    , m_unanswered(0)
+    , m_restarts(0)
+    , m_lastRevision(0)
+    , m_lastId(0)
+    , m_newestParse(0)
+    , m_newestAnswered(0)
+    , m_isAvailable(QFileInfo(backendPath).isExecutable())
+    , m_timeout(DefaultTimeoutMs)
+{
+    connect(&m_process, SIGNAL(readyReadStandardOutput()), this, SLOT(readResponses()));
+    connect(&m_process, SIGNAL(readyReadStandardError()), this, SLOT(readErrors()));
+    connect(&m_process, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SLOT(backendFinished()));
+}
+
+CompletionService::~CompletionService()
+{
+    disconnect(&m_process, 0, this, 0);
+    failPendingRequests();
+
+    if (m_process.state() == QProcess::NotRunning)
+        return;
+
+    // The backend quits once its input is closed
+    m_process.closeWriteChannel();
+    if (!m_process.waitForFinished(1000)) {
+        m_process.kill();
+        m_process.waitForFinished();
+    }
+}
+
+QString CompletionService::defaultBackendPath()
+{
+    return QCoreApplication::applicationDirPath() + QLatin1Char('/')
+            + ::Utils::HostOsInfo::withExecutableSuffix(QLatin1String("clangcompletionbackend"));
+}
+
+bool CompletionService::isAvailable() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_isAvailable;
+}
+
+int CompletionService::timeout() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_timeout;
+}
+
+void CompletionService::setTimeout(int msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_timeout = msecs;
+}
+
+bool CompletionService::complete(const CompletionServiceRequest &request,
+                                 QList<CodeCompletionResult> *results)
+{
+    if (QThread::currentThread() == thread())
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_isAvailable)
+        return false;
+
+    CompletionServiceRequest numbered = request;
+    numbered.m_id = ++m_lastId;
+    m_pending.insert(numbered.m_id);
+    m_newestRequests.insert(numbered.m_fileName, numbered.m_id);
+    queue(numbered);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!m_responses.contains(numbered.m_id)) {
+        const qint64 remaining = m_timeout - timer.elapsed();
+        if (remaining <= 0) {
+            // The late answer is dropped. A backend stuck on the unit gets replaced.
+            m_pending.remove(numbered.m_id);
+            QMetaObject::invokeMethod(this, "checkStalled", Qt::QueuedConnection);
+            results->clear();
+            return true;
+        }
+        m_responded.wait(&m_mutex, static_cast<unsigned long>(remaining));
+    }
+
+    m_pending.remove(numbered.m_id);
+    *results = m_responses.take(numbered.m_id);
+    return true;
+}
+
+void CompletionService::parse(const CompletionServiceRequest &request)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_isAvailable)
+        return;
+
+    // Not answered, numbered only to tell whether the backend got past it
+    CompletionServiceRequest numbered = request;
+    numbered.m_id = ++m_lastId;
+    m_newestParse = numbered.m_id;
+    m_newestRequests.insert(numbered.m_fileName, numbered.m_id);
+    queue(numbered);
+}
+
+bool CompletionService::isReadyFor(const QString &fileName) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_isAvailable || !m_pending.isEmpty() || m_newestParse > m_newestAnswered)
+        return false;
+
+    const quint32 newest = m_newestRequests.value(fileName);
+    return newest && newest <= m_newestAnswered;
+}
+
+// Called with the mutex locked
+void CompletionService::queue(const CompletionServiceRequest &request)
+{
+    m_outbox.append(request);
+    QMetaObject::invokeMethod(this, "send", Qt::QueuedConnection);
+}
+
+void CompletionService::send()
+{
+    CompletionServiceRequest request;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_outbox.isEmpty())
+            return;
+        request = m_outbox.takeFirst();
+    }
+
+    if (m_process.state() == QProcess::NotRunning && !startBackend()) {
+        failPendingRequests();
+        return;
+    }
+
+    // Only here, right before writing, is it known which backend gets the request.
+    leaveOutSentBuffers(&request);
+
+    if (!request.isParseOnly() && !m_unanswered++)
+        m_busySince.start();
+    m_process.write(encodeMessage(request));
+}
+
+void CompletionService::readResponses()
+{
+    m_buffer.append(m_process.readAllStandardOutput());
+
+    QByteArray payload;
+    while (takeMessage(&m_buffer, &payload)) {
+        CompletionServiceResponse response;
+        if (!decodeMessage(payload, &response))
+            continue;
+
+        m_restarts = 0;
+        if (m_unanswered > 0)
+            --m_unanswered;
+        m_busySince.start();
+
+        QMutexLocker locker(&m_mutex);
+        m_newestAnswered = qMax(m_newestAnswered, response.m_id);
+        if (m_pending.contains(response.m_id)) {
+            m_responses.insert(response.m_id, response.m_results);
+            m_responded.wakeAll();
+        }
+    }
+}
+
+void CompletionService::readErrors()
+{
+    const QByteArray errors = m_process.readAllStandardError().trimmed();
+    if (!errors.isEmpty())
+        qWarning("Clang completion backend: %s", errors.constData());
+}
+
+void CompletionService::backendFinished()
+{
+    m_buffer.clear();
+    m_unanswered = 0;
+    m_sentBuffers.clear();
+    failPendingRequests();
+
+    {
+        // The new backend starts without units
+        QMutexLocker locker(&m_mutex);
+        m_newestRequests.clear();
+        m_newestParse = 0;
+        m_newestAnswered = m_lastId;
+    }
+
+    if (++m_restarts > MaxRestarts) {
+        qWarning("Clang completion backend keeps failing, completing in-process from now on.");
+        QMutexLocker locker(&m_mutex);
+        m_isAvailable = false;
+    }
+}
+
+void CompletionService::checkStalled()
+{
+    if (m_unanswered > 0 && m_busySince.elapsed() > StallTimeoutMs) {
+        qWarning("Clang completion backend stopped answering, restarting it.");
+        m_process.kill(); // Restarted with the next request
+    }
+}
+
+bool CompletionService::startBackend()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_isAvailable)
+            return false;
+    }
+
+    m_process.start(m_backendPath, m_arguments);
+    if (m_process.waitForStarted())
+        return true;
+
+    qWarning("Could not start the clang completion backend %s: %s",
+             qPrintable(m_backendPath), qPrintable(m_process.errorString()));
+    QMutexLocker locker(&m_mutex);
+    m_isAvailable = false;
+    return false;
+}
+
+// Whoever waits gets empty results right away, instead of at the timeout.
+void CompletionService::failPendingRequests()
+{
+    QMutexLocker locker(&m_mutex);
+    foreach (quint32 id, m_pending)
+        m_responses.insert(id, QList<CodeCompletionResult>());
+    m_responded.wakeAll();
+}
+
+// Numbers the unsaved buffers of the request, and drops the contents of those the backend
+// already holds. Buffers are shared with the working copy, so an unchanged one is usually
+// the very same data and compared in no time.
+void CompletionService::leaveOutSentBuffers(CompletionServiceRequest *request)
+{
+    QHash<QString, SentBuffer> sentBuffers;
+    UnsavedFiles unsent;
+
+    QMapIterator<QString, QByteArray> it(request->m_unsavedFiles);
+    while (it.hasNext()) {
+        it.next();
+        SentBuffer buffer = m_sentBuffers.value(it.key());
+        const bool isShared = buffer.m_contents.constData() == it.value().constData()
+                && buffer.m_contents.size() == it.value().size();
+        if (!buffer.m_revision || !(isShared || buffer.m_contents == it.value())) {
+            buffer.m_revision = ++m_lastRevision;
+            buffer.m_contents = it.value();
+            unsent.insert(it.key(), it.value());
+        }
+        request->m_unsavedRevisions.insert(it.key(), buffer.m_revision);
+        sentBuffers.insert(it.key(), buffer);
+    }
+
+    // The backend drops the buffers the request doesn't mention, e.g. of saved files.
+    m_sentBuffers = sentBuffers;
+    request->m_unsavedFiles = unsent;
+}
@@ -0,0 +1,144 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef COMPLETIONSERVICE_H
+#define COMPLETIONSERVICE_H
+
+#include "completionserviceprotocol.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QProcess>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QWaitCondition>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * Runs code completion in a backend process holding the completion units, so a
+ * pathological unit can neither keep the user waiting longer than the timeout nor take
+ * the IDE and its unsaved work down with it.
+ *
+ * Requests come from the completion threads, which wait for the answer up to the timeout
+ * and get no results past it. The process is talked to from the thread the service lives
+ * in. A backend that crashed is restarted with the next request; one that doesn't answer
+ * anything for a long time is killed and restarted as well. After too many restarts in a
+ * row, the service gives up and completion runs in-process again.
+ *
+ * Requests are written in the order they were made. The unsaved buffers the backend already
+ * got are left out of them, see completionserviceprotocol.h.
+ */
+class CompletionService : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum {
+        DefaultTimeoutMs = 3000,
+        StallTimeoutMs = 30000,
+        MaxRestarts = 5
+    };
+
+    explicit CompletionService(const QString &backendPath,
+                               const QStringList &arguments = QStringList(),
+                               QObject *parent = 0);
+    ~CompletionService();
+
+    static QString defaultBackendPath();
+
+    bool isAvailable() const;
+
+    int timeout() const;
+    void setTimeout(int msecs);
+
+    // Returns false if the backend can't be used, so the caller completes in-process.
+    // That is also the case in the service's own thread, which would wait for itself.
+    bool complete(const CompletionServiceRequest &request, QList<CodeCompletionResult> *results);
+
+    // Has the backend parse the file ahead of completion, doesn't wait for it.
+    void parse(const CompletionServiceRequest &request);
+
+    // True if a completion in the file is likely answered right away: the backend got
+    // through everything sent for the file, and has nothing else queued.
+    bool isReadyFor(const QString &fileName) const;
+
+private slots:
+    void send();
+    void readResponses();
+    void readErrors();
+    void backendFinished();
+    void checkStalled();
+
+private:
+    void queue(const CompletionServiceRequest &request);
+    bool startBackend();
+    void failPendingRequests();
+    void leaveOutSentBuffers(CompletionServiceRequest *request);
+
+    struct SentBuffer
+    {
+        SentBuffer() : m_revision(0) {}
+
+        quint32 m_revision;
+        QByteArray m_contents;
+    };
+
+    const QString m_backendPath;
+    const QStringList m_arguments;
+
+    // Only used in the service's thread
+    QProcess m_process;
+    QByteArray m_buffer;
+    int m_unanswered;
+    QElapsedTimer m_busySince;
+    int m_restarts;
+    QHash<QString, SentBuffer> m_sentBuffers; // What the running backend holds
+    quint32 m_lastRevision;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_responded;
+    QList<CompletionServiceRequest> m_outbox; // Made, not written yet
+    quint32 m_lastId;
+    QSet<quint32> m_pending; // Requests someone waits for
+    QHash<quint32, QList<CodeCompletionResult> > m_responses;
+    QHash<QString, quint32> m_newestRequests; // Per file, of the running backend
+    quint32 m_newestParse;
+    quint32 m_newestAnswered; // The backend serves requests in order
+    bool m_isAvailable;
+    int m_timeout;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // COMPLETIONSERVICE_H
@@ -0,0 +1,135 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "completionserviceprotocol.h"
+
+#include <QtCore/QIODevice>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+const int kSizeLength = sizeof(quint32);
+
+template <typename Message>
+QByteArray encode(const Message &message)
+{
+    QByteArray payload;
+    QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+    payloadStream.setVersion(QDataStream::Qt_4_7);
+    payloadStream << message;
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint32(payload.size());
+    data.append(payload);
+    return data;
+}
+
+template <typename Message>
+bool decode(const QByteArray &payload, Message *message)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_4_7);
+    stream >> *message;
+    return stream.status() == QDataStream::Ok;
+}
+
+} // Anonymous
+
+namespace ClangCodeModel {
+namespace Internal {
+
+QDataStream &operator<<(QDataStream &stream, const CompletionServiceRequest &request)
+{
+    stream << request.m_id << request.m_fileName << request.m_options
+           << request.m_unsavedFiles << request.m_unsavedRevisions << request.m_line << request.m_column
+           << request.m_isSignalSlotCompletion << request.m_pchFingerprint;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, CompletionServiceRequest &request)
+{
+    stream >> request.m_id >> request.m_fileName >> request.m_options
+           >> request.m_unsavedFiles >> request.m_unsavedRevisions >> request.m_line >> request.m_column
+           >> request.m_isSignalSlotCompletion >> request.m_pchFingerprint;
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const CompletionServiceResponse &response)
+{
+    stream << response.m_id << response.m_results;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, CompletionServiceResponse &response)
+{
+    stream >> response.m_id >> response.m_results;
+    return stream;
+}
+
+QByteArray encodeMessage(const CompletionServiceRequest &request)
+{
+    return encode(request);
+}
+
+QByteArray encodeMessage(const CompletionServiceResponse &response)
+{
+    return encode(response);
+}
+
+bool takeMessage(QByteArray *buffer, QByteArray *payload)
+{
+    if (buffer->size() < kSizeLength)
+        return false;
+
+    quint32 size;
+    QDataStream stream(*buffer);
+    stream >> size;
+    if (quint32(buffer->size() - kSizeLength) < size)
+        return false;
+
+    *payload = buffer->mid(kSizeLength, size);
+    buffer->remove(0, kSizeLength + size);
+    return true;
+}
+
+bool decodeMessage(const QByteArray &payload, CompletionServiceRequest *request)
+{
+    return decode(payload, request);
+}
+
+bool decodeMessage(const QByteArray &payload, CompletionServiceResponse *response)
+{
+    return decode(payload, response);
+}
+
+} // Internal
+} // ClangCodeModel
@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef COMPLETIONSERVICEPROTOCOL_H
+#define COMPLETIONSERVICEPROTOCOL_H
+
+#include "clangcompleter.h"
+#include "utils.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDataStream>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * Messages between the plugin and the completion backend process, which holds the
+ * completion units and answers requests one after the other.
+ *
+ * On the wire, a message is the size of its payload as quint32, followed by the payload
+ * written with QDataStream.
+ *
+ * The unsaved buffers are large and rarely change between two requests, so each carries a
+ * revision and only goes over once: a request lists the revisions of all its unsaved
+ * files, but holds the contents of only those the backend hasn't seen yet. The backend
+ * keeps the contents of the revisions it was sent.
+ */
+class CompletionServiceRequest
+{
+public:
+    CompletionServiceRequest()
+        : m_id(0), m_line(0), m_column(0), m_isSignalSlotCompletion(false)
+    {}
+
+    // Without a position, the backend only parses the file, and doesn't answer.
+    bool isParseOnly() const
+    { return m_line == 0; }
+
+    quint32 m_id;
+    QString m_fileName;
+    QStringList m_options;
+    UnsavedFiles m_unsavedFiles; // Only the buffers the backend doesn't have yet, once sent
+    QHash<QString, quint32> m_unsavedRevisions; // Of all unsaved files, set by the service
+    quint32 m_line;   // As for ClangCompleter::codeCompleteAt(), starting at 1
+    quint32 m_column; // Ditto
+    bool m_isSignalSlotCompletion;
+    QByteArray m_pchFingerprint;
+};
+
+class CompletionServiceResponse
+{
+public:
+    CompletionServiceResponse()
+        : m_id(0)
+    {}
+
+    quint32 m_id;
+    QList<CodeCompletionResult> m_results;
+};
+
+QDataStream &operator<<(QDataStream &stream, const CompletionServiceRequest &request);
+QDataStream &operator>>(QDataStream &stream, CompletionServiceRequest &request);
+QDataStream &operator<<(QDataStream &stream, const CompletionServiceResponse &response);
+QDataStream &operator>>(QDataStream &stream, CompletionServiceResponse &response);
+
+QByteArray encodeMessage(const CompletionServiceRequest &request);
+QByteArray encodeMessage(const CompletionServiceResponse &response);
+
+// Takes the first complete message off the front of buffer, if there is one.
+bool takeMessage(QByteArray *buffer, QByteArray *payload);
+
+bool decodeMessage(const QByteArray &payload, CompletionServiceRequest *request);
+bool decodeMessage(const QByteArray &payload, CompletionServiceResponse *response);
+
+} // Internal
+} // ClangCodeModel
+
+#endif // COMPLETIONSERVICEPROTOCOL_H
@@ -0,0 +1,140 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "completionunitpool.h"
+#include "utils.h"
+
+#include <QtCore/QMutexLocker>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+CompletionUnitPool::CompletionUnitPool(int capacity)
+    : m_capacity(qMax(capacity, 1))
+{
+}
+
+CompletionUnitPool::~CompletionUnitPool()
+{
+}
+
+ClangCompleter::Ptr CompletionUnitPool::completer(const QString &fileName,
+                                                  const QStringList &options)
+{
+    const QByteArray &fingerprint = optionsFingerprint(options);
+
+    QMutexLocker locker(&m_mutex);
+
+    for (EntryIt it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->m_fileName != fileName)
+            continue;
+
+        if (it->m_fingerprint != fingerprint) {
+            // Stale for good, the file is now compiled differently.
+            m_entries.erase(it);
+            break;
+        }
+
+        const Entry entry = *it;
+        m_entries.erase(it);
+        m_entries.prepend(entry);
+        return entry.m_completer;
+    }
+
+    Entry entry;
+    entry.m_fileName = fileName;
+    entry.m_fingerprint = fingerprint;
+    entry.m_completer = ClangCompleter::Ptr(new ClangCompleter);
+    entry.m_completer->setFileName(fileName);
+    entry.m_completer->setOptions(options);
+    m_entries.prepend(entry);
+    shrink();
+
+    return entry.m_completer;
+}
+
+bool CompletionUnitPool::contains(const QString &fileName, const QStringList &options) const
+{
+    const QByteArray &fingerprint = optionsFingerprint(options);
+
+    QMutexLocker locker(&m_mutex);
+
+    foreach (const Entry &entry, m_entries) {
+        if (entry.m_fileName == fileName)
+            return entry.m_fingerprint == fingerprint;
+    }
+    return false;
+}
+
+void CompletionUnitPool::remove(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (EntryIt it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->m_fileName == fileName) {
+            m_entries.erase(it);
+            return;
+        }
+    }
+}
+
+void CompletionUnitPool::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_entries.clear();
+}
+
+int CompletionUnitPool::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_capacity;
+}
+
+void CompletionUnitPool::setCapacity(int capacity)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_capacity = qMax(capacity, 1);
+    shrink();
+}
+
+QByteArray CompletionUnitPool::optionsFingerprint(const QStringList &options)
+{
+    return Internal::optionsFingerprint(options);
+}
+
+void CompletionUnitPool::shrink()
+{
+    // Dropping the pointer only releases the pool's reference, a completion holding the
+    // completer keeps it alive until it's done.
+    while (m_entries.size() > m_capacity)
+        m_entries.removeLast();
+}
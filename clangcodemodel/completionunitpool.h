@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef COMPLETIONUNITPOOL_H
+#define COMPLETIONUNITPOOL_H
+
+#include "clangcompleter.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QLinkedList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * Keeps the completion translation units of the most recently completed files alive, so
+ * going back and forth between a few files (typically a header and its source) doesn't
+ * pay for a full parse each time.
+ *
+ * Units are keyed by file name and by a fingerprint of the compilation options. A unit
+ * whose options changed is replaced. The least recently used unit is dropped when the
+ * pool is full; a completer still in use by a running completion stays alive until it's
+ * released.
+ */
+class CompletionUnitPool
+{
+    Q_DISABLE_COPY(CompletionUnitPool)
+
+public:
+    enum { DefaultCapacity = 4 };
+
+    CompletionUnitPool(int capacity = DefaultCapacity);
+    ~CompletionUnitPool();
+
+    ClangCompleter::Ptr completer(const QString &fileName, const QStringList &options);
+    bool contains(const QString &fileName, const QStringList &options) const;
+    void remove(const QString &fileName);
+    void clear();
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    static QByteArray optionsFingerprint(const QStringList &options);
+
+private:
+    struct Entry
+    {
+        QString m_fileName;
+        QByteArray m_fingerprint;
+        ClangCompleter::Ptr m_completer;
+    };
+    typedef QLinkedList<Entry>::iterator EntryIt;
+
+    void shrink();
+
+    mutable QMutex m_mutex;
+    int m_capacity;
+    QLinkedList<Entry> m_entries; // Most recently used first.
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // COMPLETIONUNITPOOL_H
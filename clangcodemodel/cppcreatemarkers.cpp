@@ -29,6 +29,7 @@
 
 #include "clangutils.h"
 #include "cppcreatemarkers.h"
+#include "unit.h"
 
 #include <cplusplus/CppDocument.h>
 #include <cpptools/cppmodelmanagerinterface.h>
@@ -100,6 +101,10 @@ void CreateMarkers::run()
     m_marker->setFileName(m_fileName);
     m_marker->setCompilationOptions(m_options);
 
+    // The fast indexer works on the same TU from its own thread.
+    const Unit unit = m_marker->unit();
+    QMutexLocker unitLock(unit.mutex());
+
     m_marker->reparse(m_unsavedFiles);
 #ifdef DEBUG_TIMING
     qDebug() << "*** Reparse for highlighting took" << t.elapsed() << "ms.";
@@ -161,11 +166,13 @@ void CreateMarkers::run()
     t.restart();
 #endif // DEBUG_TIMING
 
+    unitLock.unlock();
+
     if (m_fastIndexer)
-        m_fastIndexer->indexNow(m_marker->unit());
+        m_fastIndexer->indexNow(unit);
 
 #if defined(DEBUG_TIMING) && defined(CLANG_INDEXING)
-    qDebug() << "*** Fast re-indexing took" << t.elapsed() << "ms in total.";
+    qDebug() << "*** Fast re-indexing scheduled after" << t.elapsed() << "ms.";
 #endif // DEBUG_TIMING
 }
 
@@ -64,6 +64,12 @@ public:
         dispose();
         m_cx = cx;
     }
+    CXType_T take()
+    {
+        CXType_T cx = m_cx;
+        m_cx = 0;
+        return cx;
+    }
 
 private:
     ScopedCXType(const ScopedCXType &);
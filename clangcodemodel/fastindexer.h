@@ -30,8 +30,11 @@
 #ifndef FASTINDEXER_H
 #define FASTINDEXER_H
 
+#include "symbol.h"
 #include "unit.h"
 
+#include <QtCore/QList>
+
 namespace ClangCodeModel {
 namespace Internal {
 
@@ -41,6 +44,9 @@ public:
     virtual ~FastIndexer() = 0;
 
     virtual void indexNow(const Unit &unit) = 0;
+
+    // Methods of the (qualified) class and its bases, as far as they are indexed already.
+    virtual QList<Symbol> members(const QString &qualifiedClassName) const = 0;
 };
 
 } // Internal namespace
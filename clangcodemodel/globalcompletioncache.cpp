@@ -0,0 +1,294 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "globalcompletioncache.h"
+#include "utils.h"
+#include "utils_p.h"
+
+#include <clang-c/Index.h>
+
+#include <utils/fileutils.h>
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+const quint32 kEntryMagic = 0x0A0BFFF1;
+const quint16 kEntryVersion = 1;
+
+// Entries kept in memory, one per distinct preamble and scope.
+const int kMaxEntries = 32;
+
+// How often the headers of an entry in memory are checked for changes, in ms.
+const qint64 kCheckInterval = 10000;
+
+qint64 modificationTime(const QString &fileName)
+{
+    const QFileInfo info(fileName);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+// What tells two results apart for the difference, the priority is the same for both sets.
+QString resultKey(const CodeCompletionResult &ccr)
+{
+    return QString::number(ccr.completionKind()) + QLatin1Char('\n')
+            + QString::number(ccr.availability()) + QLatin1Char('\n')
+            + QLatin1Char(ccr.hasParameters() ? '1' : '0')
+            + ccr.text() + QLatin1Char('\n')
+            + ccr.hint();
+}
+
+} // Anonymous
+
+GlobalCompletionCache::GlobalCompletionCache(const QString &directory)
+    : m_directory(directory)
+{
+    QDir().mkpath(m_directory);
+}
+
+QString GlobalCompletionCache::directory() const
+{
+    return m_directory;
+}
+
+bool GlobalCompletionCache::isSupported()
+{
+#if defined(CINDEX_VERSION) && (CINDEX_VERSION_MINOR >= 50)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Identifies a PCH by what it's built from, the PCH file itself is rebuilt in every session
+ */
+QByteArray GlobalCompletionCache::pchFingerprint(const PCHInfo::Ptr &pchInfo)
+{
+    if (pchInfo.isNull() || pchInfo->inputFileName().isEmpty())
+        return QByteArray();
+
+    const QString &input = pchInfo->inputFileName();
+    QByteArray data = input.toUtf8();
+    data += QByteArray::number(modificationTime(input));
+    data += optionsFingerprint(pchInfo->options());
+    data += pchInfo->objcWasEnabled() ? "objc" : "";
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+QByteArray GlobalCompletionCache::key(const QByteArray &pchFingerprint,
+                                      const QStringList &options,
+                                      const QStringList &includes,
+                                      const QByteArray &container)
+{
+    // The PCH file name changes with every build of it, its fingerprint stands in for it.
+    QStringList withoutPch;
+    for (int i = 0, ei = options.size(); i < ei; ++i) {
+        if (options.at(i) == QLatin1String("-include-pch") && i + 1 < ei)
+            ++i;
+        else
+            withoutPch << options.at(i);
+    }
+
+    QStringList sortedIncludes = includes;
+    sortedIncludes.sort();
+
+    QByteArray data = getQString(clang_getClangVersion()).toUtf8();
+    data += optionsFingerprint(withoutPch);
+    data += pchFingerprint;
+    data += sortedIncludes.join(QLatin1String("\n")).toUtf8();
+    data += container;
+    // Entries of a different format simply get a different key.
+    data += QByteArray::number(kEntryVersion);
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+QList<CodeCompletionResult> GlobalCompletionCache::difference(
+        const QList<CodeCompletionResult> &all,
+        const QList<CodeCompletionResult> &local)
+{
+    QHash<QString, int> localCounts;
+    foreach (const CodeCompletionResult &ccr, local)
+        ++localCounts[resultKey(ccr)];
+
+    QList<CodeCompletionResult> result;
+    foreach (const CodeCompletionResult &ccr, all) {
+        QHash<QString, int>::iterator it = localCounts.find(resultKey(ccr));
+        if (it != localCounts.end() && it.value() > 0) {
+            --it.value();
+            continue;
+        }
+
+        // Stored on disk, so the hint must not depend on the libclang results any more.
+        CodeCompletionResult global = ccr;
+        global.setHint(ccr.hint());
+        result.append(global);
+    }
+    return result;
+}
+
+bool GlobalCompletionCache::lookup(const QByteArray &key, QList<CodeCompletionResult> *results)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        // Possibly computed in a previous session.
+        Entry entry;
+        if (!load(key, &entry) || !isUpToDate(entry))
+            return false;
+        entry.m_lastChecked.start();
+
+        if (m_entries.size() >= kMaxEntries)
+            m_entries.remove(m_insertionOrder.takeFirst());
+        it = m_entries.insert(key, entry);
+        m_insertionOrder.append(key);
+    } else if (it->m_lastChecked.elapsed() > kCheckInterval) {
+        if (!isUpToDate(*it)) {
+            m_entries.erase(it);
+            m_insertionOrder.removeOne(key);
+            QFile::remove(filePath(key));
+            return false;
+        }
+        it->m_lastChecked.start();
+    }
+
+    *results = it->m_results;
+    return true;
+}
+
+void GlobalCompletionCache::insert(const QByteArray &key,
+                                   const QStringList &dependencies,
+                                   const QList<CodeCompletionResult> &results)
+{
+    Entry entry;
+    foreach (const QString &fileName, dependencies)
+        entry.m_dependencies.append(qMakePair(fileName, modificationTime(fileName)));
+    entry.m_results = results;
+    entry.m_lastChecked.start();
+
+    save(key, entry);
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_entries.contains(key)) {
+        if (m_entries.size() >= kMaxEntries)
+            m_entries.remove(m_insertionOrder.takeFirst());
+        m_insertionOrder.append(key);
+    }
+    m_entries.insert(key, entry);
+}
+
+void GlobalCompletionCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_entries.clear();
+    m_insertionOrder.clear();
+}
+
+bool GlobalCompletionCache::isUpToDate(const Entry &entry)
+{
+    for (int i = 0; i < entry.m_dependencies.size(); ++i) {
+        const QPair<QString, qint64> &dependency = entry.m_dependencies.at(i);
+        if (modificationTime(dependency.first) != dependency.second)
+            return false;
+    }
+    return true;
+}
+
+QString GlobalCompletionCache::filePath(const QByteArray &key) const
+{
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(key) + QLatin1String(".qgc");
+}
+
+bool GlobalCompletionCache::load(const QByteArray &key, Entry *entry) const
+{
+    ::Utils::FileReader reader;
+    if (!QFile::exists(filePath(key)) || !reader.fetch(filePath(key)))
+        return false;
+
+    QDataStream stream(reader.data());
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (magic != kEntryMagic || version != kEntryVersion)
+        return false;
+
+    stream.setVersion(QDataStream::Qt_4_7);
+
+    quint32 dependencyCount;
+    stream >> dependencyCount;
+    for (quint32 i = 0; i < dependencyCount && stream.status() == QDataStream::Ok; ++i) {
+        QString fileName;
+        qint64 time;
+        stream >> fileName >> time;
+        entry->m_dependencies.append(qMakePair(fileName, time));
+    }
+
+    quint32 resultCount;
+    stream >> resultCount;
+    for (quint32 i = 0; i < resultCount && stream.status() == QDataStream::Ok; ++i) {
+        CodeCompletionResult ccr;
+        stream >> ccr;
+        entry->m_results.append(ccr);
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+void GlobalCompletionCache::save(const QByteArray &key, const Entry &entry) const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << kEntryMagic << kEntryVersion;
+    stream.setVersion(QDataStream::Qt_4_7);
+
+    stream << quint32(entry.m_dependencies.size());
+    for (int i = 0; i < entry.m_dependencies.size(); ++i)
+        stream << entry.m_dependencies.at(i).first << entry.m_dependencies.at(i).second;
+
+    stream << quint32(entry.m_results.size());
+    foreach (const CodeCompletionResult &ccr, entry.m_results)
+        stream << ccr;
+
+    ::Utils::FileSaver saver(filePath(key));
+    saver.write(data);
+    if (!saver.finalize())
+        qWarning("Failed to store global completions for %s", key.constData());
+}
@@ -0,0 +1,110 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef GLOBALCOMPLETIONCACHE_H
+#define GLOBALCOMPLETIONCACHE_H
+
+#include "clangcompleter.h"
+#include "pchinfo.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * Keeps, on disk and in memory, the completion results at namespace scope that come from
+ * the PCH and the preamble of a unit: the tens of thousands of declarations of the Qt or
+ * Boost headers, which don't change while the file is edited.
+ *
+ * Entries are keyed by the PCH fingerprint, the options without the PCH file, the files
+ * the unit includes and the completion container, so units with the same preamble share
+ * them, across sessions. The container part also holds the #define and #undef directives
+ * ahead of the last #include, which change what the headers declare. Only the file-local part is then asked from libclang, with the
+ * preamble skipped. An entry is dropped as soon as one of the headers it was computed
+ * from changes on disk.
+ */
+class GlobalCompletionCache
+{
+    Q_DISABLE_COPY(GlobalCompletionCache)
+
+public:
+    explicit GlobalCompletionCache(const QString &directory);
+
+    QString directory() const;
+
+    // Whether libclang can complete without the preamble, the cache is useless otherwise.
+    static bool isSupported();
+
+    static QByteArray pchFingerprint(const PCHInfo::Ptr &pchInfo);
+    static QByteArray key(const QByteArray &pchFingerprint,
+                          const QStringList &options,
+                          const QStringList &includes,
+                          const QByteArray &container);
+
+    // The results in \a all not in \a local, the ones to be cached.
+    static QList<CodeCompletionResult> difference(const QList<CodeCompletionResult> &all,
+                                                  const QList<CodeCompletionResult> &local);
+
+    bool lookup(const QByteArray &key, QList<CodeCompletionResult> *results);
+    void insert(const QByteArray &key,
+                const QStringList &dependencies,
+                const QList<CodeCompletionResult> &results);
+    void clear();
+
+private:
+    struct Entry
+    {
+        QList<QPair<QString, qint64> > m_dependencies; // File and its modification time
+        QList<CodeCompletionResult> m_results;
+        QElapsedTimer m_lastChecked;
+    };
+
+    static bool isUpToDate(const Entry &entry);
+    QString filePath(const QByteArray &key) const;
+    bool load(const QByteArray &key, Entry *entry) const;
+    void save(const QByteArray &key, const Entry &entry) const;
+
+    QMutex m_mutex;
+    QString m_directory;
+    QHash<QByteArray, Entry> m_entries;
+    QList<QByteArray> m_insertionOrder;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // GLOBALCOMPLETIONCACHE_H
@@ -0,0 +1,230 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "includepathcache.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMetaObject>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QPair>
+#include <QtCore/QRunnable>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+// Enough for things like <QtCore/private/...> or <boost/asio/ip/...>.
+const int kPrefetchDepth = 4;
+
+// inotify watches are a limited, per user resource shared with the rest of the application.
+const int kMaxWatchedDirectories = 2048;
+
+} // Anonymous
+
+namespace ClangCodeModel {
+namespace Internal {
+
+class IncludePathScanJob : public QRunnable
+{
+public:
+    IncludePathScanJob(IncludePathCache *cache, const QString &root, int depth)
+        : m_cache(cache)
+        , m_root(root)
+        , m_depth(depth)
+    {}
+
+    void run()
+    { m_cache->scan(m_root, m_depth); }
+
+private:
+    IncludePathCache *m_cache;
+    QString m_root;
+    int m_depth;
+};
+
+} // Internal
+} // ClangCodeModel
+
+IncludePathCache::IncludePathCache(QObject *parent)
+    : QObject(parent)
+    , m_watchedCount(0)
+{
+    m_scanPool.setMaxThreadCount(1);
+
+    qRegisterMetaType<QStringList>("QStringList");
+    connect(&m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(directoryChanged(QString)));
+}
+
+IncludePathCache::~IncludePathCache()
+{
+    m_scanPool.clear();
+    m_scanPool.waitForDone();
+}
+
+void IncludePathCache::prefetch(const QStringList &paths)
+{
+    QMutexLocker locker(&m_mutex);
+
+    foreach (const QString &path, paths) {
+        const QString &cleanPath = QDir::cleanPath(path);
+        if (cleanPath.isEmpty() || m_scheduled.contains(cleanPath))
+            continue;
+        m_scheduled.insert(cleanPath);
+        m_scanPool.start(new IncludePathScanJob(this, cleanPath, kPrefetchDepth));
+    }
+}
+
+void IncludePathCache::entries(const QString &path, QStringList *files, QStringList *subdirectories)
+{
+    const QString &cleanPath = QDir::cleanPath(path);
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        QHash<QString, Directory>::const_iterator it = m_directories.constFind(cleanPath);
+        if (it != m_directories.constEnd()
+                && (it->m_isWatched
+                    || QFileInfo(cleanPath).lastModified() == it->m_lastModified)) {
+            *files = it->m_files;
+            *subdirectories = it->m_subdirectories;
+            return;
+        }
+    }
+
+    // Not known yet (or outdated and not watched), list it on the spot.
+    Directory directory;
+    const bool exists = list(cleanPath, &directory);
+    *files = directory.m_files;
+    *subdirectories = directory.m_subdirectories;
+
+    QMutexLocker locker(&m_mutex);
+    if (exists) {
+        m_directories.insert(cleanPath, directory);
+        QMetaObject::invokeMethod(this, "watch", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, QStringList(cleanPath)));
+    } else {
+        m_directories.remove(cleanPath);
+    }
+}
+
+void IncludePathCache::watch(const QStringList &directories)
+{
+    QMutexLocker locker(&m_mutex);
+
+    foreach (const QString &path, directories) {
+        if (m_watchedCount >= kMaxWatchedDirectories)
+            return;
+
+        QHash<QString, Directory>::iterator it = m_directories.find(path);
+        if (it == m_directories.end() || it->m_isWatched)
+            continue;
+
+        m_watcher.addPath(path);
+        it->m_isWatched = true;
+        ++m_watchedCount;
+    }
+}
+
+void IncludePathCache::directoryChanged(const QString &path)
+{
+    // Re-list in the background, new subdirectories one level deep. The old listing is
+    // served until then.
+    m_scanPool.start(new IncludePathScanJob(this, path, 1));
+}
+
+bool IncludePathCache::list(const QString &path, Directory *directory)
+{
+    const QFileInfo info(path);
+    if (!info.isDir())
+        return false;
+
+    directory->m_lastModified = info.lastModified();
+
+    QDirIterator it(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo &fileInfo = it.fileInfo();
+        if (fileInfo.isDir())
+            directory->m_subdirectories.append(fileInfo.fileName());
+        else
+            directory->m_files.append(fileInfo.fileName());
+    }
+    return true;
+}
+
+void IncludePathCache::scan(const QString &root, int depth)
+{
+    QStringList scanned;
+    QList<QPair<QString, int> > pending;
+    pending.append(qMakePair(root, depth));
+
+    while (!pending.isEmpty()) {
+        const QPair<QString, int> current = pending.takeFirst();
+        const QString &path = current.first;
+
+        Directory directory;
+        const bool exists = list(path, &directory);
+
+        QMutexLocker locker(&m_mutex);
+
+        QHash<QString, Directory>::iterator it = m_directories.find(path);
+        const bool isKnown = it != m_directories.end();
+        if (!exists) {
+            if (isKnown && it->m_isWatched)
+                --m_watchedCount;
+            m_directories.remove(path);
+            continue;
+        }
+
+        if (isKnown) {
+            directory.m_isWatched = it->m_isWatched;
+            *it = directory;
+        } else {
+            m_directories.insert(path, directory);
+            scanned.append(path);
+        }
+
+        if (current.second > 1) {
+            foreach (const QString &subdirectory, directory.m_subdirectories) {
+                const QString &subPath = path + QLatin1Char('/') + subdirectory;
+                // Already known subdirectories are up to date or watched themselves.
+                if (!m_directories.contains(subPath))
+                    pending.append(qMakePair(subPath, current.second - 1));
+            }
+        }
+    }
+
+    if (!scanned.isEmpty()) {
+        QMetaObject::invokeMethod(this, "watch", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, scanned));
+    }
+}
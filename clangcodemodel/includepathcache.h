@@ -0,0 +1,102 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef INCLUDEPATHCACHE_H
+#define INCLUDEPATHCACHE_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * An in-memory copy of the directory trees under the header search paths, so #include
+ * completion doesn't hit the file system (possibly a slow network mount) on every
+ * keystroke.
+ *
+ * Search paths are scanned in the background, a few levels deep, as soon as they are known
+ * (project parts updated, editor opened). Deeper or not yet scanned directories are listed
+ * on demand the first time they are asked for. Directories are kept current through a file
+ * system watcher; the ones beyond the watcher budget are checked by their modification
+ * time when looked up instead.
+ *
+ * Directories are shared, not duplicated, between the projects that search them.
+ */
+class IncludePathCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    IncludePathCache(QObject *parent = 0);
+    ~IncludePathCache();
+
+    void prefetch(const QStringList &paths);
+
+    // Lists the files and subdirectories directly within the path.
+    void entries(const QString &path, QStringList *files, QStringList *subdirectories);
+
+private slots:
+    void watch(const QStringList &directories);
+    void directoryChanged(const QString &path);
+
+private:
+    friend class IncludePathScanJob;
+
+    struct Directory
+    {
+        Directory() : m_isWatched(false) {}
+
+        QStringList m_files;
+        QStringList m_subdirectories;
+        QDateTime m_lastModified;
+        bool m_isWatched;
+    };
+
+    static bool list(const QString &path, Directory *directory);
+    void scan(const QString &root, int depth);
+
+    QMutex m_mutex;
+    QHash<QString, Directory> m_directories; // By clean path.
+    QSet<QString> m_scheduled;
+    QFileSystemWatcher m_watcher;
+    int m_watchedCount;
+    QThreadPool m_scanPool;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // INCLUDEPATHCACHE_H
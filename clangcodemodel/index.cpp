@@ -29,10 +29,12 @@
 
 #include "clangsymbolsearcher.h"
 #include "index.h"
+#include "sharedsymbolcache.h"
 
 #include <QStringList>
 #include <QLinkedList>
 #include <QHash>
+#include <QSet>
 #include <QDataStream>
 #include <QPair>
 #include <QFileInfo>
@@ -55,11 +57,21 @@ public:
     IndexPrivate();
 
     void insertSymbol(const Symbol &symbol, const QDateTime &timeStamp);
+    void replaceFile(const QString &fileName,
+                     const QVector<Symbol> &symbols,
+                     const QDateTime &timeStamp);
+    void replaceSharedFile(const QString &fileName,
+                           const QByteArray &sharedKey,
+                           const QVector<Symbol> &symbols,
+                           const QDateTime &timeStamp);
+    QByteArray sharedKey(const QString &fileName) const;
     QList<Symbol> symbols(const QString &fileName) const;
     QList<Symbol> symbols(const QString &fileName, Symbol::Kind kind) const;
     QList<Symbol> symbols(const QString &fileName, Symbol::Kind kind, const QString &uqName) const;
     QList<Symbol> symbols(const QString &fileName, const QString &uqName) const;
     QList<Symbol> symbols(Symbol::Kind kind) const;
+    QList<Symbol> derivedClasses(const QString &qualifiedName, bool transitive) const;
+    QList<Symbol> members(const QString &qualifiedClassName) const;
 
     void match(ClangSymbolSearcher *searcher) const;
 
@@ -73,11 +85,16 @@ public:
 
     bool isEmpty() const;
 
+    int symbolCount() const;
+    qint64 approximateMemoryUsage() const;
+
     void trackTimeStamp(const Symbol &symbol, const QDateTime &timeStamp);
     void trackTimeStamp(const QString &fileName, const QDateTime &timeStamp);
 
     bool validate(const QString &fileName) const;
 
+    void setSharedSymbolCache(SharedSymbolCache *cache);
+
     QByteArray serialize() const;
     void deserialize(const QByteArray &data);
 
@@ -103,15 +120,25 @@ private:
 
     void createIndexes(SymbolIt it);
     QList<SymbolIt> removeIndexes(const QString &fileName);
+    void removeDerivedIndexes(SymbolIt it);
+    void createMemberIndexes(SymbolIt it);
+    void removeMemberIndexes(SymbolIt it);
 
     static QList<Symbol> symbolsFromIterators(const QList<SymbolIt> &symbolList);
+    static qint64 footprint(const Symbol &symbol);
 
     // @TODO: Sharing of compilation options...
 
     mutable QMutex m_mutex;
     SymbolCont m_container;
     FileIndex m_files;
+    QHash<QString, QList<SymbolIt> > m_derived; // By qualified name of the base class.
+    QHash<QString, QList<SymbolIt> > m_classes; // By qualified name.
+    QHash<QString, QList<SymbolIt> > m_members; // Methods, by qualified name of the class.
     QHash<QString, QDateTime> m_timeStamps;
+    QHash<QString, QByteArray> m_sharedFiles;
+    SharedSymbolCache *m_sharedCache;
+    qint64 m_approximateSize;
 };
 
 } // namespace Internal
@@ -122,12 +149,61 @@ using namespace Internal;
 
 IndexPrivate::IndexPrivate()
     : m_mutex(QMutex::Recursive)
+    , m_sharedCache(0)
+    , m_approximateSize(0)
 {
 }
 
 void IndexPrivate::createIndexes(SymbolIt it)
 {
     m_files[it->m_location.fileName()][it->m_kind][it->m_name].append(it);
+    foreach (const QString &base, it->m_baseClasses)
+        m_derived[base].append(it);
+    createMemberIndexes(it);
+}
+
+void IndexPrivate::removeDerivedIndexes(SymbolIt it)
+{
+    foreach (const QString &base, it->m_baseClasses) {
+        QList<SymbolIt> &derived = m_derived[base];
+        derived.removeOne(it);
+        if (derived.isEmpty())
+            m_derived.remove(base);
+    }
+}
+
+static QString enclosingScope(const QString &qualification)
+{
+    const int separator = qualification.lastIndexOf(QLatin1String("::"));
+    return separator == -1 ? QString() : qualification.left(separator);
+}
+
+void IndexPrivate::createMemberIndexes(SymbolIt it)
+{
+    if (it->m_kind == Symbol::Class)
+        m_classes[it->m_qualification].append(it);
+    else if (it->m_kind == Symbol::Method)
+        m_members[enclosingScope(it->m_qualification)].append(it);
+}
+
+void IndexPrivate::removeMemberIndexes(SymbolIt it)
+{
+    QHash<QString, QList<SymbolIt> > *index;
+    QString key;
+    if (it->m_kind == Symbol::Class) {
+        index = &m_classes;
+        key = it->m_qualification;
+    } else if (it->m_kind == Symbol::Method) {
+        index = &m_members;
+        key = enclosingScope(it->m_qualification);
+    } else {
+        return;
+    }
+
+    QList<SymbolIt> &symbols = (*index)[key];
+    symbols.removeOne(it);
+    if (symbols.isEmpty())
+        index->remove(key);
 }
 
 QList<QLinkedList<Symbol>::iterator> IndexPrivate::removeIndexes(const QString &fileName)
@@ -143,6 +219,10 @@ QList<QLinkedList<Symbol>::iterator> IndexPrivate::removeIndexes(const QString &
         for (; nit != neit; ++nit)
             iterators.append(*nit);
     }
+    foreach (SymbolIt symbolIt, iterators) {
+        removeDerivedIndexes(symbolIt);
+        removeMemberIndexes(symbolIt);
+    }
     return iterators;
 }
 
@@ -152,6 +232,7 @@ void IndexPrivate::insertSymbol(const Symbol &symbol)
 
     SymbolIt it = m_container.insert(m_container.begin(), symbol);
     createIndexes(it);
+    m_approximateSize += footprint(symbol);
 }
 
 void IndexPrivate::insertSymbol(const Symbol &symbol, const QDateTime &timeStamp)
@@ -165,6 +246,38 @@ void IndexPrivate::insertSymbol(const Symbol &symbol, const QDateTime &timeStamp
     trackTimeStamp(symbol, timeStamp);
 }
 
+void IndexPrivate::replaceFile(const QString &fileName,
+                               const QVector<Symbol> &symbols,
+                               const QDateTime &timeStamp)
+{
+    // Readers must never observe the file half updated, so the whole swap happens under
+    // a single lock.
+    QMutexLocker locker(&m_mutex);
+
+    removeFile(fileName);
+    foreach (const Symbol &symbol, symbols)
+        insertSymbol(symbol, timeStamp);
+    trackTimeStamp(fileName, timeStamp);
+}
+
+void IndexPrivate::replaceSharedFile(const QString &fileName,
+                                     const QByteArray &sharedKey,
+                                     const QVector<Symbol> &symbols,
+                                     const QDateTime &timeStamp)
+{
+    QMutexLocker locker(&m_mutex);
+
+    replaceFile(fileName, symbols, timeStamp);
+    m_sharedFiles.insert(fileName, sharedKey);
+}
+
+QByteArray IndexPrivate::sharedKey(const QString &fileName) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_sharedFiles.value(fileName);
+}
+
 QPair<bool, IndexPrivate::SymbolIndexIt> IndexPrivate::findEquivalentSymbol(const Symbol &symbol)
 {
     // Despite the loop below finding a symbol should be efficient, since we already filter
@@ -191,12 +304,22 @@ void IndexPrivate::updateEquivalentSymbol(SymbolIndexIt it, const Symbol &symbol
     Q_ASSERT(symbolIt->m_location.fileName() == symbol.m_location.fileName());
 
     symbolIt->m_location = symbol.m_location;
+    symbolIt->m_access = symbol.m_access;
+    if (symbolIt->m_baseClasses != symbol.m_baseClasses) {
+        removeDerivedIndexes(symbolIt);
+        symbolIt->m_baseClasses = symbol.m_baseClasses;
+        foreach (const QString &base, symbolIt->m_baseClasses)
+            m_derived[base].append(symbolIt);
+    }
 }
 
 void IndexPrivate::removeSymbol(SymbolIndexIt it)
 {
     SymbolIt symbolIt = *it;
 
+    m_approximateSize -= footprint(*symbolIt);
+    removeDerivedIndexes(symbolIt);
+    removeMemberIndexes(symbolIt);
     m_container.erase(symbolIt);
 
     KindIndex &kindIndex = m_files[symbolIt->m_location.fileName()];
@@ -259,6 +382,49 @@ QList<Symbol> IndexPrivate::symbols(Symbol::Kind kind) const
     return all;
 }
 
+QList<Symbol> IndexPrivate::derivedClasses(const QString &qualifiedName, bool transitive) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QList<Symbol> all;
+    QSet<QString> visited;
+    visited.insert(qualifiedName);
+    QStringList pending(qualifiedName);
+    while (!pending.isEmpty()) {
+        const QString base = pending.takeFirst();
+        foreach (SymbolIt it, m_derived.value(base)) {
+            // Diamonds and classes defined in several configurations are reported once.
+            if (visited.contains(it->m_qualification))
+                continue;
+            visited.insert(it->m_qualification);
+            all.append(*it);
+            if (transitive)
+                pending.append(it->m_qualification);
+        }
+    }
+    return all;
+}
+
+QList<Symbol> IndexPrivate::members(const QString &qualifiedClassName) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QList<Symbol> all;
+    QSet<QString> visited;
+    QStringList pending(qualifiedClassName);
+    while (!pending.isEmpty()) {
+        const QString klass = pending.takeFirst();
+        if (visited.contains(klass))
+            continue;
+        visited.insert(klass);
+
+        all.append(symbolsFromIterators(m_members.value(klass)));
+        foreach (SymbolIt it, m_classes.value(klass))
+            pending.append(it->m_baseClasses);
+    }
+    return all;
+}
+
 void IndexPrivate::match(ClangSymbolSearcher *searcher) const
 {
     QMutexLocker locker(&m_mutex);
@@ -274,6 +440,31 @@ QList<Symbol> IndexPrivate::symbolsFromIterators(const QList<SymbolIt> &symbolLi
     return all;
 }
 
+int IndexPrivate::symbolCount() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_container.size();
+}
+
+qint64 IndexPrivate::approximateMemoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_approximateSize;
+}
+
+qint64 IndexPrivate::footprint(const Symbol &symbol)
+{
+    // The symbol itself, its list node, the iterator kept in the name index and the strings.
+    // File names are implicitly shared in practice, so this errs on the generous side.
+    return sizeof(Symbol) + 2 * sizeof(void *) + sizeof(SymbolIt)
+            + (symbol.m_name.size()
+               + symbol.m_qualification.size()
+               + symbol.m_location.fileName().size()
+               + symbol.m_baseClasses.join(QString()).size()) * sizeof(QChar);
+}
+
 void IndexPrivate::trackTimeStamp(const Symbol &symbol, const QDateTime &timeStamp)
 {
     QMutexLocker locker(&m_mutex);
@@ -330,10 +521,13 @@ void IndexPrivate::removeFile(const QString &fileName)
     QMutexLocker locker(&m_mutex);
 
     const QList<SymbolIt> &iterators = removeIndexes(fileName);
-    foreach (SymbolIt it, iterators)
+    foreach (SymbolIt it, iterators) {
+        m_approximateSize -= footprint(*it);
         m_container.erase(it);
+    }
 
     m_timeStamps.remove(fileName);
+    m_sharedFiles.remove(fileName);
 }
 
 void IndexPrivate::removeFiles(const QStringList &fileNames)
@@ -350,7 +544,12 @@ void IndexPrivate::clear()
 
     m_container.clear();
     m_files.clear();
+    m_derived.clear();
+    m_classes.clear();
+    m_members.clear();
     m_timeStamps.clear();
+    m_sharedFiles.clear();
+    m_approximateSize = 0;
 }
 
 bool IndexPrivate::isEmpty() const
@@ -360,6 +559,13 @@ bool IndexPrivate::isEmpty() const
     return m_timeStamps.isEmpty();
 }
 
+void IndexPrivate::setSharedSymbolCache(SharedSymbolCache *cache)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_sharedCache = cache;
+}
+
 QByteArray IndexPrivate::serialize() const
 {
     QMutexLocker locker(&m_mutex);
@@ -367,11 +573,19 @@ QByteArray IndexPrivate::serialize() const
     QByteArray data;
     QDataStream stream(&data, QIODevice::WriteOnly);
 
+    // Symbols of shared files are already on disk in the shared cache, only the key is stored.
+    SymbolCont ownSymbols;
+    foreach (const Symbol &symbol, m_container) {
+        if (!m_sharedFiles.contains(symbol.m_location.fileName()))
+            ownSymbols.append(symbol);
+    }
+
     stream << (quint32)0x0A0BFFEE;
-    stream << (quint16)1;
+    stream << (quint16)4;
     stream.setVersion(QDataStream::Qt_4_7);
-    stream << m_container;
+    stream << ownSymbols;
     stream << m_timeStamps;
+    stream << m_sharedFiles;
 
     return data;
 }
@@ -382,8 +596,6 @@ void IndexPrivate::deserialize(const QByteArray &data)
 
     clear();
 
-    // @TODO: Version compatibility handling.
-
     QDataStream stream(data);
 
     quint32 header;
@@ -393,7 +605,9 @@ void IndexPrivate::deserialize(const QByteArray &data)
 
     quint16 indexVersion;
     stream >> indexVersion;
-    if (indexVersion != 1)
+    // Older versions lack the class hierarchy or the access of members, so they are
+    // indexed from scratch.
+    if (indexVersion != 4)
         return;
 
     stream.setVersion(QDataStream::Qt_4_7);
@@ -402,11 +616,25 @@ void IndexPrivate::deserialize(const QByteArray &data)
     stream >> symbols;
     stream >> m_timeStamps;
 
+    QHash<QString, QByteArray> sharedFiles;
+    stream >> sharedFiles;
+
     // @TODO: Overload the related functions with batch versions.
     foreach (const Symbol &symbol, symbols)
         insertSymbol(symbol);
-}
 
+    QHash<QString, QByteArray>::const_iterator it = sharedFiles.constBegin();
+    for (; it != sharedFiles.constEnd(); ++it) {
+        if (m_sharedCache && m_sharedCache->contains(it.value())) {
+            foreach (const Symbol &symbol, m_sharedCache->symbols(it.value(), it.key()))
+                insertSymbol(symbol);
+            m_sharedFiles.insert(it.key(), it.value());
+        } else {
+            // The entry is gone (or there is no cache), forget the file so it's indexed again.
+            m_timeStamps.remove(it.key());
+        }
+    }
+}
 
 Index::Index()
     : d(new IndexPrivate)
@@ -420,6 +648,26 @@ void Index::insertSymbol(const Symbol &symbol, const QDateTime &timeStamp)
     d->insertSymbol(symbol, timeStamp);
 }
 
+void Index::replaceFile(const QString &fileName,
+                        const QVector<Symbol> &symbols,
+                        const QDateTime &timeStamp)
+{
+    d->replaceFile(fileName, symbols, timeStamp);
+}
+
+void Index::replaceSharedFile(const QString &fileName,
+                              const QByteArray &sharedKey,
+                              const QVector<Symbol> &symbols,
+                              const QDateTime &timeStamp)
+{
+    d->replaceSharedFile(fileName, sharedKey, symbols, timeStamp);
+}
+
+QByteArray Index::sharedKey(const QString &fileName) const
+{
+    return d->sharedKey(fileName);
+}
+
 QList<Symbol> Index::symbols(const QString &fileName) const
 {
     return d->symbols(fileName);
@@ -440,6 +688,16 @@ QList<Symbol> Index::symbols(Symbol::Kind kind) const
     return d->symbols(kind);
 }
 
+QList<Symbol> Index::derivedClasses(const QString &qualifiedName, bool transitive) const
+{
+    return d->derivedClasses(qualifiedName, transitive);
+}
+
+QList<Symbol> Index::members(const QString &qualifiedClassName) const
+{
+    return d->members(qualifiedClassName);
+}
+
 void Index::match(ClangSymbolSearcher *searcher) const
 {
     d->match(searcher);
@@ -480,11 +738,26 @@ bool Index::isEmpty() const
     return d->isEmpty();
 }
 
+int Index::symbolCount() const
+{
+    return d->symbolCount();
+}
+
+qint64 Index::approximateMemoryUsage() const
+{
+    return d->approximateMemoryUsage();
+}
+
 bool Index::validate(const QString &fileName) const
 {
     return d->validate(fileName);
 }
 
+void Index::setSharedSymbolCache(SharedSymbolCache *cache)
+{
+    d->setSharedSymbolCache(cache);
+}
+
 QByteArray Index::serialize() const
 {
     return d->serialize();
@@ -35,6 +35,7 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QString>
 #include <QtCore/QList>
+#include <QtCore/QVector>
 #include <QtCore/QScopedPointer>
 #include <QtCore/QDateTime>
 #include <QStringList>
@@ -47,6 +48,7 @@ namespace Internal {
 
 class ClangSymbolSearcher;
 class IndexPrivate;
+class SharedSymbolCache;
 
 class Index
 {
@@ -55,11 +57,26 @@ public:
     ~Index();
 
     void insertSymbol(const Symbol &symbol, const QDateTime &timeStamp);
+    void replaceFile(const QString &fileName,
+                     const QVector<Symbol> &symbols,
+                     const QDateTime &timeStamp);
+    // Like replaceFile(), but the symbols come from the shared cache and are therefore
+    // persisted only as a reference to the cache entry.
+    void replaceSharedFile(const QString &fileName,
+                           const QByteArray &sharedKey,
+                           const QVector<Symbol> &symbols,
+                           const QDateTime &timeStamp);
+    QByteArray sharedKey(const QString &fileName) const;
     QList<Symbol> symbols(const QString &fileName) const;
     QList<Symbol> symbols(const QString &fileName, Symbol::Kind kind) const;
     QList<Symbol> symbols(const QString &fileName, Symbol::Kind kind, const QString &uqName) const;
     QList<Symbol> symbols(Symbol::Kind kind) const;
 
+    // Classes deriving from the given (qualified) class, directly or not.
+    QList<Symbol> derivedClasses(const QString &qualifiedName, bool transitive = true) const;
+    // Methods of the given (qualified) class and of its base classes.
+    QList<Symbol> members(const QString &qualifiedClassName) const;
+
     void match(ClangSymbolSearcher *searcher) const;
 
     void insertFile(const QString &fileName, const QDateTime &timeStamp);
@@ -74,6 +91,11 @@ public:
 
     bool isEmpty() const;
 
+    int symbolCount() const;
+    qint64 approximateMemoryUsage() const;
+
+    void setSharedSymbolCache(SharedSymbolCache *cache);
+
     QByteArray serialize() const;
     void deserialize(const QByteArray &data);
 
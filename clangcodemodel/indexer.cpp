@@ -30,6 +30,7 @@
 #include "clangutils.h"
 #include "indexer.h"
 #include "index.h"
+#include "indexermetrics.h"
 #include "cxraii.h"
 #include "sourcelocation.h"
 #include "liveunitsmanager.h"
@@ -37,12 +38,15 @@
 #include "clangsymbolsearcher.h"
 #include "pchmanager.h"
 #include "raii/scopedclangoptions.h"
+#include "sharedsymbolcache.h"
+#include "sharedclangindex.h"
 
 #include <clang-c/Index.h>
 
 #include <coreplugin/editormanager/editormanager.h>
 #include <coreplugin/icore.h>
 #include <coreplugin/progressmanager/progressmanager.h>
+#include <projectexplorer/project.h>
 #include <utils/fileutils.h>
 #include <utils/QtConcurrentTools>
 
@@ -59,6 +63,8 @@
 #include <QRunnable>
 #include <QThreadPool>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QAtomicInt>
 #include <QStringBuilder>
 
 #include <cassert>
@@ -86,22 +92,28 @@ struct IndexingResult
     typedef CppTools::ProjectPart ProjectPart;
 
     IndexingResult()
+        : m_isMainFile(false)
     {}
 
     IndexingResult(const QVector<Symbol> &symbol,
                    const QSet<QString> &processedFiles,
                    const Unit &unit,
-                   const ProjectPart::Ptr &projectPart)
+                   const ProjectPart::Ptr &projectPart,
+                   const QByteArray &sharedKey = QByteArray())
         : m_symbolsInfo(symbol)
         , m_processedFiles(processedFiles)
         , m_unit(unit)
         , m_projectPart(projectPart)
+        , m_sharedKey(sharedKey)
+        , m_isMainFile(false)
     {}
 
     QVector<Symbol> m_symbolsInfo;
     QSet<QString> m_processedFiles;
     Unit m_unit;
     ProjectPart::Ptr m_projectPart;
+    QByteArray m_sharedKey; // Set for files whose symbols go through the shared cache.
+    bool m_isMainFile; // The file of the unit, rather than one it includes.
 };
 
 class LibClangIndexer;
@@ -144,7 +156,14 @@ public:
         unsigned m_managementOptions;
     };
 
-    void synchronize(const QVector<IndexingResult> &results);
+    // How the results of an indexer are published into the index.
+    enum PublishMode {
+        MergeSymbols,           // Add to whatever is already known about a file.
+        ReplaceSymbols          // Swap the symbols of the main file in one go, merge the rest.
+    };
+
+    void synchronize(const QVector<IndexingResult> &results, PublishMode mode);
+    void fileProcessed();
     void finished(LibClangIndexer *indexer);
     bool noIndexersRunning() const;
 
@@ -153,11 +172,13 @@ private:
 
     void indexingFinished();
     void cancelIndexing();
-    int runningIndexerCount() const;
+    void cancelQuickIndexing();
 
 public slots:
     void dependencyGraphComputed();
     void restoredSymbolsAnalysed();
+    void indexingCanceled();
+    void runQueued();
 
 public:
     enum IndexingMode {
@@ -177,7 +198,6 @@ public:
     void runCore(const QHash<QString, FileData> &headers,
                           const QHash<QString, FileData> &impls,
                           IndexingMode mode);
-    void watchIndexingThreads(QFutureInterface<void> &future);
     bool isBusy() const;
     void cancel(bool wait);
     void reset();
@@ -190,6 +210,8 @@ public:
     QStringList allFiles() const;
     bool isTrackingFile(const QString &fileName, FileType type) const;
     static FileType identifyFileType(const QString &fileName);
+    static QString partName(const ProjectPart::Ptr &part);
+    static QStringList projectRoots();
     static void populateFileNames(QStringList *all, const QList<FileData> &data);
     QStringList compilationOptions(const QString &fileName) const;
 
@@ -198,6 +220,8 @@ public:
 
     QList<Symbol> symbols(Symbol::Kind kind) const;
     QList<Symbol> symbols(const QString &fileName, const Symbol::Kind kind) const;
+    QList<Symbol> derivedClasses(const QString &qualifiedClassName) const;
+    QList<Symbol> members(const QString &qualifiedClassName) const;
     void match(ClangSymbolSearcher *searcher) const;
 
     Indexer *m_q;
@@ -210,8 +234,14 @@ public:
 //    DependencyGraph m_dependencyGraph;
     QScopedPointer<QFutureWatcher<void> >m_loadingWatcher;
     QScopedPointer<QFutureWatcher<void> >m_indexingWatcher;
+    QFutureInterface<void> m_indexingFuture;
+    QAtomicInt m_processedFileCount;
     QThreadPool m_indexingPool;
     QSet<LibClangIndexer *> m_runningIndexers;
+    QThreadPool m_quickIndexingPool;
+    QHash<QString, LibClangIndexer *> m_runningQuickIndexers;
+    QScopedPointer<SharedSymbolCache> m_sharedCache;
+    IndexerMetrics m_metrics;
 };
 
 } // ClangCodeModel
@@ -238,11 +268,18 @@ protected:
     typedef CppTools::ProjectPart ProjectPart;
 
 public:
-    LibClangIndexer(IndexerPrivate *indexer)
+    LibClangIndexer(IndexerPrivate *indexer,
+                    IndexerPrivate::PublishMode publishMode = IndexerPrivate::MergeSymbols)
         : m_indexer(indexer)
+        , m_publishMode(publishMode)
         , m_isCanceled(false)
     {}
 
+    // Headers outside of these directories have their symbols looked up in (and stored to)
+    // the shared cache, instead of being indexed over and over again.
+    void setSharedFiles(const QStringList &projectRoots)
+    { m_projectRoots = projectRoots; }
+
     virtual ~LibClangIndexer()
     {}
 
@@ -257,15 +294,31 @@ protected:
             indexingResults.reserve(m_allFiles.size());
 
             foreach (const QString &fn, m_allFiles.keys()) {
-                QVector<ClangCodeModel::Symbol> symbols; unfoldSymbols(symbols, fn);
+                const File *f = m_allFiles.value(fn);
+                if (f->isKnownShared())
+                    continue;
+
+                // Included files are reported for every #include, also when their contents
+                // aren't entered, as for guarded re-includes or headers covered by the PCH
+                // whose AST was indexed with an earlier file. Without declarations from this
+                // unit, the symbols would be none or partial, which must neither replace
+                // what the index has nor end up in the shared cache.
+                if (f->isUncachedShared() && f->symbols().isEmpty())
+                    continue;
+
+                QVector<ClangCodeModel::Symbol> symbols;
+                if (!f->isCachedShared())
+                    unfoldSymbols(symbols, fn);
                 QSet<QString> processedFiles = QSet<QString>::fromList(m_allFiles.keys());
                 Unit unit(fn);
-                IndexingResult indexingResult(symbols, processedFiles, unit, projectPart);
+                IndexingResult indexingResult(symbols, processedFiles, unit, projectPart,
+                                              f->sharedKey());
+                indexingResult.m_isMainFile = f->isMainFile();
                 indexingResults.append(indexingResult);
 
                 // TODO: includes need to be propagated to the dependency table.
             }
-            m_indexer->synchronize(indexingResults);
+            m_indexer->synchronize(indexingResults, m_publishMode);
         }
 
         qDeleteAll(m_allFiles.values());
@@ -310,7 +363,11 @@ protected:
         clang_indexLoc_getFileLocation(info->hashLoc, reinterpret_cast<CXIdxClientFile*>(&includingFile), 0, 0, 0, 0);
 
         const QString fileName = getQString(clang_getFileName(info->file));
-        File *f = indexer(client_data)->file(fileName);
+        LibClangIndexer *lci = indexer(client_data);
+        const bool isNew = !lci->m_allFiles.contains(fileName);
+        File *f = lci->file(fileName);
+        if (isNew)
+            lci->classifySharedFile(f);
 
         if (includingFile)
             includingFile->addInclude(f);
@@ -343,12 +400,24 @@ protected:
         unsigned line = 0, column = 0, offset = 0;
         clang_indexLoc_getFileLocation(info->loc, reinterpret_cast<CXIdxClientFile*>(&includingFile), 0, &line, &column, &offset);
 
+        // The symbols of this file are already available from the shared cache.
+        if (includingFile && includingFile->skipsSymbols())
+            return;
+
         QString kind = getQString(clang_getCursorKindSpelling(info->cursor.kind));
         QString displayName = getQString(clang_getCursorDisplayName(info->cursor));
         QString spellingName = getQString(clang_getCursorSpelling(info->cursor));
 //        qDebug() << (includingFile ? includingFile->name() : QLatin1String("<UNKNOWN FILE>")) << ":"<<line<<":"<<column<<": display name ="<<displayName<<"spelling name ="<<spellingName<<"of kind"<<kind;
 
         Symbol *sym = lci->newSymbol(info->cursor.kind, displayName, spellingName, includingFile, line, column, offset);
+        sym->access = clang_getCXXAccessSpecifier(info->cursor);
+
+        if (const CXIdxCXXClassDeclInfo *classInfo = clang_index_getCXXClassDeclInfo(info)) {
+            for (unsigned i = 0; i < classInfo->numBases; ++i) {
+                if (const CXIdxEntityInfo *base = classInfo->bases[i]->base)
+                    sym->baseClasses.append(qualifiedName(base->cursor));
+            }
+        }
 
         // TODO: add to decl container...
         if (includingFile) // TODO: check why includingFile can be null...
@@ -368,6 +437,18 @@ protected:
             clang_index_setClientContainer(info->declAsContainer, sym);
     }
 
+    // Matches the qualification built by unfoldSymbols(), so bases can be looked up by it.
+    static QString qualifiedName(CXCursor cursor)
+    {
+        QString name = getQString(clang_getCursorSpelling(cursor));
+        for (CXCursor parent = clang_getCursorSemanticParent(cursor);
+             !clang_isInvalid(parent.kind) && !clang_isTranslationUnit(parent.kind);
+             parent = clang_getCursorSemanticParent(parent)) {
+            name = getQString(clang_getCursorSpelling(parent)) + QLatin1String("::") + name;
+        }
+        return name;
+    }
+
     static void indexEntityReference(CXClientData client_data, const CXIdxEntityRefInfo *info) {
         Q_UNUSED(client_data);
         Q_UNUSED(info);
@@ -384,6 +465,8 @@ protected:
     {
         File(const QString &fileName)
             : m_fileName(fileName)
+            , m_isMainFile(false)
+            , m_sharedState(NotShared)
         {}
 
         void addInclude(File *f)
@@ -413,11 +496,38 @@ protected:
         QVector<Symbol *> symbols() const
         { return m_symbols; }
 
+        enum SharedState {
+            NotShared,
+            UncachedShared,     // Symbols are collected and then stored in the shared cache.
+            CachedShared,       // Symbols are taken from the shared cache.
+            KnownShared         // The index already holds the symbols from the shared cache.
+        };
+
+        void setShared(SharedState state, const QByteArray &key)
+        { m_sharedState = state; m_sharedKey = key; }
+
+        QByteArray sharedKey() const
+        { return m_sharedKey; }
+
+        bool isUncachedShared() const
+        { return m_sharedState == UncachedShared; }
+
+        bool isCachedShared() const
+        { return m_sharedState == CachedShared; }
+
+        bool isKnownShared() const
+        { return m_sharedState == KnownShared; }
+
+        bool skipsSymbols() const
+        { return m_sharedState == CachedShared || m_sharedState == KnownShared; }
+
     private:
         QString m_fileName;
         FilesByName m_includes;
         bool m_isMainFile;
         QVector<Symbol *> m_symbols;
+        SharedState m_sharedState;
+        QByteArray m_sharedKey;
     };
 
     struct Symbol
@@ -431,6 +541,7 @@ protected:
             , column(column)
             , offset(offset)
             , semanticContainer(0)
+            , access(CX_CXXInvalidAccessSpecifier)
         {}
 
         QString spellKind() const
@@ -445,6 +556,8 @@ protected:
         unsigned line, column, offset;
         Symbol *semanticContainer;
         QVector<Symbol *> symbols;
+        QStringList baseClasses;
+        enum CX_CXXAccessSpecifier access;
     };
 
 protected:
@@ -464,6 +577,30 @@ protected:
         return f;
     }
 
+    void classifySharedFile(File *f)
+    {
+        SharedSymbolCache *cache = m_indexer->m_sharedCache.data();
+        if (m_projectRoots.isEmpty() || m_sharedFingerprint.isEmpty() || !cache)
+            return;
+
+        const QString &fileName = f->name();
+        foreach (const QString &root, m_projectRoots) {
+            if (fileName.startsWith(root))
+                return;
+        }
+
+        const QByteArray &key = cache->keyFor(fileName, m_sharedFingerprint);
+        if (key.isEmpty())
+            return;
+
+        if (m_indexer->m_index.sharedKey(fileName) == key)
+            f->setShared(File::KnownShared, key);
+        else if (cache->contains(key))
+            f->setShared(File::CachedShared, key);
+        else
+            f->setShared(File::UncachedShared, key);
+    }
+
     Symbol *newSymbol(enum CXCursorKind kind, const QString &displayName, const QString &spellingName, File *file, unsigned line, unsigned column, unsigned offset)
     {
         Symbol *s = new Symbol(kind, displayName, spellingName, file, line, column, offset);
@@ -520,6 +657,13 @@ protected:
             sym.m_qualification = parent->spellingName + sep + sym.m_qualification;
 
         sym.m_location = SourceLocation(s->file->name(), s->line, s->column, s->offset);
+        sym.m_baseClasses = s->baseClasses;
+
+        switch (s->access) {
+        case CX_CXXProtected: sym.m_access = ClangCodeModel::Symbol::Protected; break;
+        case CX_CXXPrivate: sym.m_access = ClangCodeModel::Symbol::Private; break;
+        default: sym.m_access = ClangCodeModel::Symbol::Public; break;
+        }
 
         switch (s->kind) {
         case CXCursor_EnumDecl: sym.m_kind = ClangCodeModel::Symbol::Enum; break;
@@ -542,7 +686,10 @@ protected:
 
 protected:
     IndexerPrivate *m_indexer;
+    IndexerPrivate::PublishMode m_publishMode;
     bool m_isCanceled;
+    QStringList m_projectRoots;
+    QByteArray m_sharedFingerprint;
     QHash<QString, bool> m_importedASTs;
     FilesByName  m_allFiles;
     QVector<Symbol *> m_allSymbols;
@@ -569,20 +716,27 @@ public:
 
     void run()
     {
-        if (isCanceled() || m_todo.isEmpty()) {
+        if (m_todo.isEmpty()) {
             finish();
             return;
         }
 
         const ProjectPart::Ptr &pPart = m_todo[0].m_projectPart;
+        const QString partName = IndexerPrivate::partName(pPart);
+        if (isCanceled()) {
+            m_indexer->m_metrics.filesSkipped(partName, m_todo.size());
+            finish();
+            return;
+        }
 
 restart:
-        CXIndex idx;
-        if (!(idx = clang_createIndex(/* excludeDeclsFromPCH */ 1,
-                                      /* displayDiagnosics=*/1))) {
+        const SharedClangIndex sharedIdx = SharedClangIndex::acquire(SharedClangIndex::IndexingUsage);
+        if (sharedIdx.isNull()) {
           qDebug() << "Could not create Index";
+          m_indexer->m_metrics.filesSkipped(partName, m_todo.size());
           return;
         }
+        CXIndex idx = sharedIdx.index();
 
         CXIndexAction idxAction = clang_IndexAction_create(idx);
         const unsigned index_opts = CXIndexOpt_SuppressWarnings;
@@ -592,12 +746,14 @@ restart:
 
         for (int i = 0, ei = m_todo.size(); i < ei; ++i) {
             const IndexerPrivate::FileData &fd = m_todo.at(i);
-            if (fd.m_upToDate)
+            if (fd.m_upToDate) {
+                m_indexer->m_metrics.filesSkipped(partName, 1);
                 continue;
+            }
 
             if (pchManager->pchInfo(pPart) != pchInfo) {
                 clang_IndexAction_dispose(idxAction);
-                clang_disposeIndex(idx);
+                m_indexer->m_metrics.pchRestarted();
                 goto restart;
             }
 
@@ -607,11 +763,15 @@ restart:
 
             ScopedClangOptions scopedOpts(opts);
             QByteArray fileName = fd.m_fileName.toUtf8();
+            m_sharedFingerprint = SharedSymbolCache::optionsFingerprint(opts);
 
 //            qDebug() << "Indexing file" << fd.m_fileName << "with options" << opts;
             unsigned parsingOptions = fd.m_managementOptions;
             parsingOptions |= CXTranslationUnit_SkipFunctionBodies;
 
+            QElapsedTimer parseTimer;
+            parseTimer.start();
+
             /*int result =*/ clang_indexSourceFile(idxAction, this,
                                                    &IndexCB, sizeof(IndexCB),
                                                    index_opts, fileName.constData(),
@@ -635,15 +795,19 @@ restart:
                 m_importedASTs[astFile] = true;
             }
 
+            m_indexer->m_metrics.fileIndexed(partName, parseTimer.nsecsElapsed() / 1000);
+
             propagateResults(fd.m_projectPart);
-            if (isCanceled())
+            m_indexer->fileProcessed();
+            if (isCanceled()) {
+                m_indexer->m_metrics.filesSkipped(partName, ei - i - 1);
                 break;
+            }
         }
 
 //        dumpInfo();
 
         clang_IndexAction_dispose(idxAction);
-        clang_disposeIndex(idx);
 
         finish();
     }
@@ -656,30 +820,44 @@ class QuickIndexer: public LibClangIndexer
 {
 public:
     QuickIndexer(IndexerPrivate *indexer, const Unit &unit, const ProjectPart::Ptr &projectPart)
-        : LibClangIndexer(indexer)
+        : LibClangIndexer(indexer, IndexerPrivate::ReplaceSymbols)
         , m_unit(unit)
         , m_projectPart(projectPart)
     {}
 
     void run()
     {
-        if (isCanceled() || !m_unit.isLoaded()) {
-            finish();
-            return;
-        }
+        // The unit is shared with the editor's highlighter, so it is only touched while holding
+        // its own lock. The results are published afterwards, without holding it.
+        {
+            QMutexLocker unitLock(m_unit.mutex());
+            if (isCanceled() || !m_unit.isLoaded()) {
+                unitLock.unlock();
+                finish();
+                return;
+            }
 
-        CXIndexAction idxAction = clang_IndexAction_create(m_unit.clangIndex());
-        const unsigned index_opts = CXIndexOpt_SuppressWarnings;
+            // External headers go through the shared cache, as in a full run.
+            m_sharedFingerprint = SharedSymbolCache::optionsFingerprint(m_unit.compilationOptions());
 
-//        qDebug() << "Indexing TU" << m_unit.fileName() << "...";
-        /*int result =*/ clang_indexTranslationUnit(idxAction, this,
-                                                    &IndexCB, sizeof(IndexCB),
-                                                    index_opts,
-                                                    m_unit.clangTranslationUnit());
+            QElapsedTimer parseTimer;
+            parseTimer.start();
 
-        propagateResults(m_projectPart);
+            CXIndexAction idxAction = clang_IndexAction_create(m_unit.clangIndex());
+            const unsigned index_opts = CXIndexOpt_SuppressWarnings;
 
-        clang_IndexAction_dispose(idxAction);
+//            qDebug() << "Indexing TU" << m_unit.fileName() << "...";
+            /*int result =*/ clang_indexTranslationUnit(idxAction, this,
+                                                        &IndexCB, sizeof(IndexCB),
+                                                        index_opts,
+                                                        m_unit.clangTranslationUnit());
+
+            clang_IndexAction_dispose(idxAction);
+
+            m_indexer->m_metrics.quickIndexed(parseTimer.nsecsElapsed() / 1000);
+        }
+
+        propagateResults(m_projectPart);
         finish();
     }
 
@@ -698,11 +876,20 @@ IndexerPrivate::IndexerPrivate(Indexer *indexer)
     , m_isLoaded(false)
     , m_loadingWatcher(new QFutureWatcher<void>)
     , m_indexingWatcher(new QFutureWatcher<void>)
+    , m_sharedCache(new SharedSymbolCache(Core::ICore::userResourcePath()
+                                          + QLatin1String("/codemodel/shared")))
 {
 //    const int magicThreadCount = QThread::idealThreadCount() * 4 / 3;
     const int magicThreadCount = QThread::idealThreadCount() - 1;
     m_indexingPool.setMaxThreadCount(std::max(magicThreadCount, 1));
     m_indexingPool.setExpiryTimeout(1000);
+
+    // Quick indexing gets a lane of its own, so it never queues behind a full run.
+    m_quickIndexingPool.setMaxThreadCount(1);
+
+    m_index.setSharedSymbolCache(m_sharedCache.data());
+
+    connect(m_indexingWatcher.data(), SIGNAL(canceled()), this, SLOT(indexingCanceled()));
 }
 
 void IndexerPrivate::runCore(const QHash<QString, FileData> & /*headers*/,
@@ -726,36 +913,33 @@ void IndexerPrivate::runCore(const QHash<QString, FileData> & /*headers*/,
     if (parts.isEmpty())
         return;
 
+    int fileCount = 0;
+    for (PartIter i = parts.begin(), ei = parts.end(); i != ei; ++i)
+        fileCount += i.value().size();
+
+    // Progress and completion are driven by the indexers themselves, see fileProcessed()
+    // and finished().
+    m_indexingFuture = QFutureInterface<void>();
+    m_indexingFuture.setProgressRange(0, fileCount);
+    m_indexingFuture.reportStarted();
+    m_processedFileCount = 0;
+
+    const QStringList &roots = projectRoots();
+
+    m_metrics.runStarted();
     for (PartIter i = parts.begin(), ei = parts.end(); i != ei; ++i) {
+        m_metrics.filesQueued(partName(i.key()), i.value().size());
         ProjectPartIndexer *ppi = new ProjectPartIndexer(this, i.value());
+        ppi->setSharedFiles(roots);
         m_runningIndexers.insert(ppi);
         m_indexingPool.start(ppi);
     }
 
-    QFuture<void> task = QtConcurrent::run(&IndexerPrivate::watchIndexingThreads, this);
+    QFuture<void> task = m_indexingFuture.future();
     m_indexingWatcher->setFuture(task);
     emit m_q->indexingStarted(task);
 }
 
-void IndexerPrivate::watchIndexingThreads(QFutureInterface<void> &future)
-{
-    int maxTodo = runningIndexerCount();
-    future.setProgressRange(0, maxTodo);
-
-    int todo = -1;
-    while (todo) {
-        int newTodo = runningIndexerCount();
-        if (todo != newTodo)
-            future.setProgressValue(maxTodo - newTodo);
-        todo = newTodo;
-        if (future.isCanceled()) {
-            cancelIndexing();
-            return;
-        }
-        m_indexingPool.waitForDone(500);
-    }
-}
-
 void IndexerPrivate::run()
 {
     Q_ASSERT(m_isLoaded);
@@ -810,11 +994,11 @@ void IndexerPrivate::cancel(bool wait)
 
     m_loadingWatcher->cancel();
     cancelIndexing();
+    cancelQuickIndexing();
     if (wait) {
         m_loadingWatcher->waitForFinished();
-        m_indexingWatcher->waitForFinished();
-        while (!noIndexersRunning())
-            m_indexingPool.waitForDone(100);
+        m_indexingPool.waitForDone();
+        m_quickIndexingPool.waitForDone();
     }
 }
 
@@ -829,23 +1013,65 @@ void IndexerPrivate::reset()
     m_queuedFilesRun.clear();
     m_storagePath.clear();
     m_index.clear();
+    m_metrics.indexFootprintChanged(0, 0);
     m_isLoaded = false;
 }
 
-void IndexerPrivate::synchronize(const QVector<IndexingResult> &results)
+void IndexerPrivate::synchronize(const QVector<IndexingResult> &results, PublishMode mode)
 {
+    QElapsedTimer publishTimer;
+    publishTimer.start();
+
+    // The shared cache is on disk, so it's dealt with before taking the lock.
+    QVector<IndexingResult> prepared;
+    prepared.reserve(results.size());
     foreach (IndexingResult result, results) {
-        QMutexLocker locker(&m_mutex);
+        if (!result.m_sharedKey.isEmpty()) {
+            if (m_sharedCache->contains(result.m_sharedKey)) {
+                result.m_symbolsInfo = m_sharedCache->symbols(result.m_sharedKey,
+                                                              result.m_unit.fileName());
+            } else if (!result.m_symbolsInfo.isEmpty()) {
+                m_sharedCache->store(result.m_sharedKey, result.m_symbolsInfo);
+            } else {
+                // Not indexed in that unit, see LibClangIndexer::propagateResults().
+                continue;
+            }
+        }
+        prepared.append(result);
+    }
 
-        result.m_unit.makeUnique();
+    QElapsedTimer lockTimer;
+    lockTimer.start();
+    QMutexLocker locker(&m_mutex);
+    const qint64 lockWait = lockTimer.nsecsElapsed() / 1000;
 
-        foreach (const Symbol &symbol, result.m_symbolsInfo) {
-            addOrUpdateFileData(symbol.m_location.fileName(),
-                                result.m_projectPart,
-                                true);
+    foreach (IndexingResult result, prepared) {
+        result.m_unit.makeUnique();
 
-            // Make the symbol available in the database.
-            m_index.insertSymbol(symbol, result.m_unit.timeStamp());
+        if (!result.m_sharedKey.isEmpty()) {
+            addOrUpdateFileData(result.m_unit.fileName(), result.m_projectPart, true);
+            m_index.replaceSharedFile(result.m_unit.fileName(),
+                                      result.m_sharedKey,
+                                      result.m_symbolsInfo,
+                                      result.m_unit.timeStamp());
+        } else if (mode == ReplaceSymbols && result.m_isMainFile) {
+            // All symbols of a result come from the same file.
+            if (!result.m_symbolsInfo.isEmpty())
+                addOrUpdateFileData(result.m_unit.fileName(), result.m_projectPart, true);
+            m_index.replaceFile(result.m_unit.fileName(),
+                                result.m_symbolsInfo,
+                                result.m_unit.timeStamp());
+        } else {
+            // Headers are merged, also when re-indexing a unit: it may see only part of
+            // them, as for guarded re-includes, and other units contribute to them too.
+            foreach (const Symbol &symbol, result.m_symbolsInfo) {
+                addOrUpdateFileData(symbol.m_location.fileName(),
+                                    result.m_projectPart,
+                                    true);
+
+                // Make the symbol available in the database.
+                m_index.insertSymbol(symbol, result.m_unit.timeStamp());
+            }
         }
 
         // There might be files which were processed but did not "generate" any indexable symbol,
@@ -860,15 +1086,32 @@ void IndexerPrivate::synchronize(const QVector<IndexingResult> &results)
         if (LiveUnitsManager::instance()->isTracking(result.m_unit.fileName()))
             LiveUnitsManager::instance()->updateUnit(result.m_unit.fileName(), result.m_unit);
     }
+
+    m_metrics.indexFootprintChanged(m_index.symbolCount(), m_index.approximateMemoryUsage());
+    m_metrics.resultsPublished(publishTimer.nsecsElapsed() / 1000, lockWait);
 }
 
 void IndexerPrivate::finished(LibClangIndexer *indexer)
 {
     QMutexLocker locker(&m_mutex);
 
-    m_runningIndexers.remove(indexer);
-    if (noIndexersRunning())
+    if (!m_runningIndexers.remove(indexer)) {
+        // A quick indexer, unless it was already superseded by a newer one for the same file.
+        const QString fileName = m_runningQuickIndexers.key(indexer);
+        if (!fileName.isNull())
+            m_runningQuickIndexers.remove(fileName);
+        return;
+    }
+
+    if (noIndexersRunning()) {
+        m_indexingFuture.reportFinished();
         indexingFinished();
+    }
+}
+
+void IndexerPrivate::fileProcessed()
+{
+    m_indexingFuture.setProgressValue(m_processedFileCount.fetchAndAddRelaxed(1) + 1);
 }
 
 bool IndexerPrivate::noIndexersRunning() const
@@ -880,6 +1123,23 @@ bool IndexerPrivate::noIndexersRunning() const
 
 void IndexerPrivate::indexingFinished()
 {
+    m_metrics.runFinished();
+
+    emit m_q->indexingFinished();
+
+    // This is called from the thread of the last indexer. Queued runs are started from the
+    // thread this object lives in instead, so the watcher is never touched from elsewhere.
+    if (m_hasQueuedFullRun || !m_queuedFilesRun.isEmpty())
+        QMetaObject::invokeMethod(this, "runQueued", Qt::QueuedConnection);
+}
+
+void IndexerPrivate::runQueued()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_isLoaded || !noIndexersRunning())
+        return;
+
     if (m_hasQueuedFullRun) {
         m_hasQueuedFullRun = false;
         run();
@@ -888,8 +1148,12 @@ void IndexerPrivate::indexingFinished()
         m_queuedFilesRun.clear();
         run(files);
     }
+}
 
-    emit m_q->indexingFinished();
+void IndexerPrivate::indexingCanceled()
+{
+    // Triggered by the user through the progress indicator.
+    cancelIndexing();
 }
 
 void IndexerPrivate::cancelIndexing()
@@ -901,10 +1165,12 @@ void IndexerPrivate::cancelIndexing()
     }
 }
 
-int IndexerPrivate::runningIndexerCount() const
+void IndexerPrivate::cancelQuickIndexing()
 {
     QMutexLocker locker(&m_mutex);
-    return m_runningIndexers.size();
+
+    foreach (LibClangIndexer *quickIndexer, m_runningQuickIndexers)
+        quickIndexer->cancel();
 }
 
 void IndexerPrivate::addOrUpdateFileData(const QString &fileName,
@@ -978,6 +1244,25 @@ IndexerPrivate::FileType IndexerPrivate::identifyFileType(const QString &fileNam
     return HeaderFile;
 }
 
+QString IndexerPrivate::partName(const ProjectPart::Ptr &part)
+{
+    if (part.isNull())
+        return QLatin1String("<no project part>");
+    return part->displayName;
+}
+
+// Directories of the open projects, with a trailing separator
+QStringList IndexerPrivate::projectRoots()
+{
+    QStringList roots;
+    CppTools::CppModelManagerInterface *mmi = CppTools::CppModelManagerInterface::instance();
+    foreach (const CppTools::CppModelManagerInterface::ProjectInfo &pi, mmi->projectInfos()) {
+        if (pi.project())
+            roots.append(QDir::cleanPath(pi.project()->projectDirectory()) + QLatin1Char('/'));
+    }
+    return roots;
+}
+
 void IndexerPrivate::populateFileNames(QStringList *all, const QList<FileData> &data)
 {
     foreach (const FileData &fileData, data)
@@ -1086,12 +1371,29 @@ void IndexerPrivate::analyzeRestoredSymbols()
 
 void IndexerPrivate::runQuickIndexing(const Unit &unit, const CppTools::ProjectPart::Ptr &part)
 {
+    const QString fileName = normalizeFileName(unit.fileName());
+    if (fileName.isEmpty())
+        return;
+
     QMutexLocker locker(&m_mutex);
 
-    addOrUpdateFileData(unit.fileName(), part, false);
+    // The symbols currently in the index stay visible until the new ones replace them.
+    const FileType fileType = identifyFileType(fileName);
+    if (isTrackingFile(fileName, fileType)) {
+        m_files[fileType][fileName].m_projectPart = part;
+        m_files[fileType][fileName].m_upToDate = false;
+    } else {
+        m_files[fileType].insert(fileName, FileData(fileName, part));
+    }
+
+    // Only the most recent state of a file is worth indexing.
+    if (LibClangIndexer *previous = m_runningQuickIndexers.value(fileName))
+        previous->cancel();
 
-    QuickIndexer indexer(this, unit, part);
-    indexer.run();
+    QuickIndexer *indexer = new QuickIndexer(this, unit, part);
+    indexer->setSharedFiles(projectRoots());
+    m_runningQuickIndexers.insert(fileName, indexer);
+    m_quickIndexingPool.start(indexer);
 }
 
 void IndexerPrivate::restoredSymbolsAnalysed()
@@ -1146,6 +1448,22 @@ QList<Symbol> IndexerPrivate::symbols(const QString &fileName, const Symbol::Kin
     return m_index.symbols(fileName, kind);
 }
 
+QList<Symbol> IndexerPrivate::derivedClasses(const QString &qualifiedClassName) const
+{
+    if (m_loadingWatcher->isRunning())
+        return QList<Symbol>();
+
+    return m_index.derivedClasses(qualifiedClassName);
+}
+
+QList<Symbol> IndexerPrivate::members(const QString &qualifiedClassName) const
+{
+    if (m_loadingWatcher->isRunning())
+        return QList<Symbol>();
+
+    return m_index.members(qualifiedClassName);
+}
+
 void IndexerPrivate::match(ClangSymbolSearcher *searcher) const
 {
     if (m_loadingWatcher->isRunning())
@@ -1273,6 +1591,16 @@ QList<Symbol> Indexer::allFromFile(const QString &fileName) const
     return m_d->symbols(fileName, Symbol::Unknown);
 }
 
+QList<Symbol> Indexer::derivedClasses(const QString &qualifiedClassName) const
+{
+    return m_d->derivedClasses(qualifiedClassName);
+}
+
+QList<Symbol> Indexer::members(const QString &qualifiedClassName) const
+{
+    return m_d->members(qualifiedClassName);
+}
+
 void Indexer::match(ClangSymbolSearcher *searcher) const
 {
     m_d->match(searcher);
@@ -1283,4 +1611,9 @@ void Indexer::runQuickIndexing(const Unit &unit, const CppTools::ProjectPart::Pt
     m_d->runQuickIndexing(unit, part);
 }
 
+IndexerMetrics *Indexer::metrics() const
+{
+    return &m_d->m_metrics;
+}
+
 #include "indexer.moc"
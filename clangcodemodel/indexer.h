@@ -46,6 +46,7 @@ namespace ClangCodeModel {
 
 namespace Internal {
 class ClangSymbolSearcher;
+class IndexerMetrics;
 } // namespace Internal
 
 class IndexerPrivate;
@@ -85,10 +86,17 @@ public:
     QList<Symbol> destructorsFromFile(const QString &fileName) const;
     QList<Symbol> allFromFile(const QString &fileName) const;
 
+    // All classes deriving from the given qualified class name, directly or indirectly.
+    QList<Symbol> derivedClasses(const QString &qualifiedClassName) const;
+    // The methods of the given qualified class and of its base classes.
+    QList<Symbol> members(const QString &qualifiedClassName) const;
+
     void match(Internal::ClangSymbolSearcher *searcher) const;
 
     void runQuickIndexing(const Internal::Unit &unit, const ProjectPart::Ptr &part);
 
+    Internal::IndexerMetrics *metrics() const;
+
 signals:
     void indexingStarted(QFuture<void> future);
     void indexingFinished();
@@ -0,0 +1,257 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "indexermetrics.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QStringList>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+QString formatUsecs(qint64 usecs)
+{
+    if (usecs < 1000)
+        return QString::fromLatin1("%1 us").arg(usecs);
+    return QString::fromLatin1("%1 ms").arg(usecs / 1000);
+}
+
+} // Anonymous
+
+LatencyHistogram::LatencyHistogram()
+    : m_buckets(BucketCount, 0)
+    , m_count(0)
+    , m_total(0)
+    , m_max(0)
+{}
+
+void LatencyHistogram::addSample(qint64 usecs)
+{
+    int bucket = 0;
+    for (qint64 msecs = usecs / 1000; msecs && bucket < BucketCount - 1; msecs >>= 1)
+        ++bucket;
+
+    ++m_buckets[bucket];
+    ++m_count;
+    m_total += usecs;
+    m_max = qMax(m_max, usecs);
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int bucket)
+{
+    return (qint64(1) << bucket) * 1000;
+}
+
+qint64 LatencyHistogram::percentile(int percent) const
+{
+    if (!m_count)
+        return 0;
+
+    const quint64 wanted = (m_count * percent + 99) / 100;
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount - 1; ++i) {
+        seen += m_buckets.at(i);
+        if (seen >= wanted)
+            return qMin(bucketUpperBound(i), m_max);
+    }
+    return m_max;
+}
+
+QString LatencyHistogram::toString() const
+{
+    if (!m_count)
+        return QLatin1String("no samples");
+
+    QString s = QString::fromLatin1("n=%1 avg=%2 p50<=%3 p95<=%4 max=%5")
+            .arg(m_count)
+            .arg(formatUsecs(average()))
+            .arg(formatUsecs(percentile(50)))
+            .arg(formatUsecs(percentile(95)))
+            .arg(formatUsecs(m_max));
+
+    QStringList buckets;
+    for (int i = 0; i < BucketCount; ++i) {
+        if (!m_buckets.at(i))
+            continue;
+        const QString bound = (i == BucketCount - 1)
+                ? QString::fromLatin1(">=%1ms").arg(bucketUpperBound(i - 1) / 1000)
+                : QString::fromLatin1("<%1ms").arg(bucketUpperBound(i) / 1000);
+        buckets << bound + QLatin1Char(':') + QString::number(m_buckets.at(i));
+    }
+    return s + QLatin1String("\n      ") + buckets.join(QLatin1String(" "));
+}
+
+IndexerMetrics::IndexerMetrics()
+    : m_symbolCount(0)
+    , m_indexBytes(0)
+{
+    reset();
+}
+
+void IndexerMetrics::runStarted()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_runTimer.start();
+    m_filesInRun = 0;
+}
+
+void IndexerMetrics::runFinished()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_runTimer.isValid())
+        m_lastRunMsecs = m_runTimer.elapsed();
+    m_runTimer.invalidate();
+    m_queueDepth.clear();
+}
+
+void IndexerMetrics::filesQueued(const QString &partName, int count)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_queueDepth[partName] += count;
+}
+
+void IndexerMetrics::fileIndexed(const QString &partName, qint64 parseUsecs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    dequeue(partName, 1);
+    ++m_filesInRun;
+    ++m_filesIndexed;
+    m_parseLatency.addSample(parseUsecs);
+}
+
+void IndexerMetrics::filesSkipped(const QString &partName, int count)
+{
+    QMutexLocker locker(&m_mutex);
+
+    dequeue(partName, count);
+}
+
+void IndexerMetrics::quickIndexed(qint64 parseUsecs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    ++m_quickIndexed;
+    m_quickLatency.addSample(parseUsecs);
+}
+
+void IndexerMetrics::resultsPublished(qint64 publishUsecs, qint64 lockWaitUsecs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_publishLatency.addSample(publishUsecs);
+    m_lockWait.addSample(lockWaitUsecs);
+}
+
+void IndexerMetrics::pchRestarted()
+{
+    QMutexLocker locker(&m_mutex);
+
+    ++m_pchRestarts;
+}
+
+void IndexerMetrics::indexFootprintChanged(int symbolCount, qint64 approximateBytes)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_symbolCount = symbolCount;
+    m_indexBytes = approximateBytes;
+}
+
+void IndexerMetrics::reset()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_runTimer.invalidate();
+    m_lastRunMsecs = 0;
+    m_filesInRun = 0;
+    m_filesIndexed = 0;
+    m_quickIndexed = 0;
+    m_pchRestarts = 0;
+    m_queueDepth.clear();
+    m_parseLatency = LatencyHistogram();
+    m_quickLatency = LatencyHistogram();
+    m_publishLatency = LatencyHistogram();
+    m_lockWait = LatencyHistogram();
+}
+
+QString IndexerMetrics::report() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QString r;
+    r += QString::fromLatin1("Clang indexer metrics (%1)\n")
+            .arg(QDateTime::currentDateTime().toString(Qt::ISODate));
+
+    if (m_runTimer.isValid()) {
+        const qint64 elapsed = qMax(m_runTimer.elapsed(), qint64(1));
+        r += QString::fromLatin1("Indexing: running for %1 s, %2 files, %3 files/s\n")
+                .arg(elapsed / 1000)
+                .arg(m_filesInRun)
+                .arg(m_filesInRun * 1000.0 / elapsed, 0, 'f', 1);
+    } else {
+        r += QString::fromLatin1("Indexing: idle, last run took %1 s\n").arg(m_lastRunMsecs / 1000);
+    }
+
+    r += QString::fromLatin1("Files indexed: %1 (quick: %2), PCH restarts: %3\n")
+            .arg(m_filesIndexed).arg(m_quickIndexed).arg(m_pchRestarts);
+    r += QString::fromLatin1("Index: %1 symbols, ~%2 KiB\n")
+            .arg(m_symbolCount).arg(m_indexBytes / 1024);
+
+    r += QLatin1String("Queue depth per project part:\n");
+    if (m_queueDepth.isEmpty())
+        r += QLatin1String("  (empty)\n");
+    QHash<QString, int>::const_iterator it = m_queueDepth.constBegin();
+    for (; it != m_queueDepth.constEnd(); ++it)
+        r += QString::fromLatin1("  %1: %2\n").arg(it.key()).arg(it.value());
+
+    r += QLatin1String("Parse latency:       ") + m_parseLatency.toString() + QLatin1Char('\n');
+    r += QLatin1String("Quick index latency: ") + m_quickLatency.toString() + QLatin1Char('\n');
+    r += QLatin1String("Publish latency:     ") + m_publishLatency.toString() + QLatin1Char('\n');
+    r += QLatin1String("Lock wait:           ") + m_lockWait.toString() + QLatin1Char('\n');
+
+    return r;
+}
+
+// Called with the mutex held.
+void IndexerMetrics::dequeue(const QString &partName, int count)
+{
+    QHash<QString, int>::iterator it = m_queueDepth.find(partName);
+    if (it == m_queueDepth.end())
+        return;
+    it.value() -= count;
+    if (it.value() <= 0)
+        m_queueDepth.erase(it);
+}
@@ -0,0 +1,130 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef INDEXERMETRICS_H
+#define INDEXERMETRICS_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * Latency distribution with power-of-two millisecond buckets: bucket 0 holds samples
+ * below 1 ms, bucket i holds samples in [2^(i-1), 2^i) ms, and the last bucket
+ * everything above.
+ */
+class LatencyHistogram
+{
+public:
+    enum { BucketCount = 16 };
+
+    LatencyHistogram();
+
+    void addSample(qint64 usecs);
+
+    quint64 count() const
+    { return m_count; }
+
+    qint64 maximum() const
+    { return m_max; }
+
+    qint64 average() const
+    { return m_count ? m_total / qint64(m_count) : 0; }
+
+    // An upper bound of the given percentile, in microseconds.
+    qint64 percentile(int percent) const;
+
+    QString toString() const;
+
+private:
+    static qint64 bucketUpperBound(int bucket);
+
+    QVector<quint64> m_buckets;
+    quint64 m_count;
+    qint64 m_total;
+    qint64 m_max;
+};
+
+/*
+ * Counters and timings gathered by the indexer. Recording is cheap enough to stay enabled
+ * all the time, and every method may be called from any thread.
+ */
+class IndexerMetrics
+{
+    Q_DISABLE_COPY(IndexerMetrics)
+
+public:
+    IndexerMetrics();
+
+    void runStarted();
+    void runFinished();
+
+    void filesQueued(const QString &partName, int count);
+    void fileIndexed(const QString &partName, qint64 parseUsecs);
+    // Queued files that won't be indexed, being up to date or the run canceled.
+    void filesSkipped(const QString &partName, int count);
+    void quickIndexed(qint64 parseUsecs);
+    void resultsPublished(qint64 publishUsecs, qint64 lockWaitUsecs);
+    void pchRestarted();
+    void indexFootprintChanged(int symbolCount, qint64 approximateBytes);
+
+    // Clears counters and histograms. The index footprint is a state, so it is kept.
+    void reset();
+
+    // Human readable report of the current state, suitable for bug reports.
+    QString report() const;
+
+private:
+    void dequeue(const QString &partName, int count);
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_runTimer;
+    qint64 m_lastRunMsecs;
+    int m_filesInRun;
+    quint64 m_filesIndexed;
+    quint64 m_quickIndexed;
+    int m_pchRestarts;
+    int m_symbolCount;
+    qint64 m_indexBytes;
+    QHash<QString, int> m_queueDepth;
+    LatencyHistogram m_parseLatency;
+    LatencyHistogram m_quickLatency;
+    LatencyHistogram m_publishLatency;
+    LatencyHistogram m_lockWait;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // INDEXERMETRICS_H
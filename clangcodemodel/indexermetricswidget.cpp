@@ -0,0 +1,157 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "indexermetrics.h"
+#include "indexermetricswidget.h"
+#include "sharedunits.h"
+
+#include <utils/fileutils.h>
+
+#include <QCoreApplication>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QTimer>
+#include <QToolButton>
+#include <QVBoxLayout>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+static const char INDEXER_METRICS_VIEW_ID[] = "ClangCodeModel.IndexerMetrics";
+
+IndexerMetricsWidget::IndexerMetricsWidget(IndexerMetrics *metrics, QWidget *parent)
+    : QWidget(parent)
+    , m_metrics(metrics)
+    , m_view(new QPlainTextEdit(this))
+    , m_refreshTimer(new QTimer(this))
+{
+    m_view->setReadOnly(true);
+    m_view->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_view->setFont(QFont(QLatin1String("Monospace")));
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setMargin(0);
+    layout->addWidget(m_view);
+
+    // Only poll while visible, the metrics themselves are recorded regardless.
+    m_refreshTimer->setInterval(1000);
+    connect(m_refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+}
+
+void IndexerMetricsWidget::refresh()
+{
+    const int scrollPosition = m_view->verticalScrollBar()->value();
+    m_view->setPlainText(report());
+    m_view->verticalScrollBar()->setValue(scrollPosition);
+}
+
+void IndexerMetricsWidget::dumpToFile()
+{
+    const QString fileName = QFileDialog::getSaveFileName(
+                this, tr("Save Indexer Metrics"), QString(), tr("Text files (*.txt)"));
+    if (fileName.isEmpty())
+        return;
+
+    ::Utils::FileSaver saver(fileName, QIODevice::Text);
+    saver.write(report().toUtf8());
+    if (!saver.finalize())
+        QMessageBox::warning(this, tr("Save Indexer Metrics"), saver.errorString());
+}
+
+void IndexerMetricsWidget::resetMetrics()
+{
+    m_metrics->reset();
+    refresh();
+}
+
+QString IndexerMetricsWidget::report() const
+{
+    QString r = m_metrics->report();
+    if (SharedUnits *sharedUnits = SharedUnits::instance()) {
+        r += QLatin1Char('\n');
+        r += sharedUnits->memoryReport();
+    }
+    return r;
+}
+
+void IndexerMetricsWidget::showEvent(QShowEvent *event)
+{
+    refresh();
+    m_refreshTimer->start();
+    QWidget::showEvent(event);
+}
+
+void IndexerMetricsWidget::hideEvent(QHideEvent *event)
+{
+    m_refreshTimer->stop();
+    QWidget::hideEvent(event);
+}
+
+IndexerMetricsNavigationWidgetFactory::IndexerMetricsNavigationWidgetFactory(IndexerMetrics *metrics)
+    : m_metrics(metrics)
+{
+}
+
+QString IndexerMetricsNavigationWidgetFactory::displayName() const
+{
+    return QCoreApplication::translate("ClangCodeModel::Internal::IndexerMetricsWidget",
+                                       "Clang Indexer");
+}
+
+int IndexerMetricsNavigationWidgetFactory::priority() const
+{
+    return 900;
+}
+
+Core::Id IndexerMetricsNavigationWidgetFactory::id() const
+{
+    return Core::Id(INDEXER_METRICS_VIEW_ID);
+}
+
+Core::NavigationView IndexerMetricsNavigationWidgetFactory::createWidget()
+{
+    IndexerMetricsWidget *widget = new IndexerMetricsWidget(m_metrics);
+
+    QToolButton *dump = new QToolButton;
+    dump->setText(IndexerMetricsWidget::tr("Dump"));
+    dump->setToolTip(IndexerMetricsWidget::tr("Save the current metrics to a file."));
+    QObject::connect(dump, SIGNAL(clicked()), widget, SLOT(dumpToFile()));
+
+    QToolButton *reset = new QToolButton;
+    reset->setText(IndexerMetricsWidget::tr("Reset"));
+    reset->setToolTip(IndexerMetricsWidget::tr("Clear all counters and histograms."));
+    QObject::connect(reset, SIGNAL(clicked()), widget, SLOT(resetMetrics()));
+
+    Core::NavigationView view;
+    view.widget = widget;
+    view.dockToolBarWidgets << dump << reset;
+    return view;
+}
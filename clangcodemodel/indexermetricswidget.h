@@ -0,0 +1,90 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef INDEXERMETRICSWIDGET_H
+#define INDEXERMETRICSWIDGET_H
+
+#include <coreplugin/inavigationwidgetfactory.h>
+
+#include <QWidget>
+
+QT_BEGIN_NAMESPACE
+class QPlainTextEdit;
+class QTimer;
+QT_END_NAMESPACE
+
+namespace ClangCodeModel {
+namespace Internal {
+
+class IndexerMetrics;
+
+class IndexerMetricsWidget: public QWidget
+{
+    Q_OBJECT
+
+public:
+    IndexerMetricsWidget(IndexerMetrics *metrics, QWidget *parent = 0);
+
+public slots:
+    void refresh();
+    void dumpToFile();
+    void resetMetrics();
+
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+
+private:
+    QString report() const;
+
+    IndexerMetrics *m_metrics;
+    QPlainTextEdit *m_view;
+    QTimer *m_refreshTimer;
+};
+
+class IndexerMetricsNavigationWidgetFactory: public Core::INavigationWidgetFactory
+{
+    Q_OBJECT
+
+public:
+    IndexerMetricsNavigationWidgetFactory(IndexerMetrics *metrics);
+
+    QString displayName() const;
+    int priority() const;
+    Core::Id id() const;
+    Core::NavigationView createWidget();
+
+private:
+    IndexerMetrics *m_metrics;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // INDEXERMETRICSWIDGET_H
@@ -31,6 +31,8 @@
 
 #include <coreplugin/idocument.h>
 
+#include <QtCore/QMutexLocker>
+
 using namespace ClangCodeModel;
 using namespace Internal;
 
@@ -51,13 +53,24 @@ LiveUnitsManager::~LiveUnitsManager()
 
 void LiveUnitsManager::requestTracking(const QString &fileName)
 {
-    if (!fileName.isEmpty() && !isTracking(fileName))
+    QMutexLocker locker(&m_mutex);
+
+    if (!fileName.isEmpty() && !m_units.contains(fileName))
         m_units.insert(fileName, Unit(fileName));
 }
 
+bool LiveUnitsManager::isTracking(const QString &fileName) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_units.contains(fileName);
+}
+
 void LiveUnitsManager::cancelTrackingRequest(const QString &fileName)
 {
-    if (!isTracking(fileName))
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_units.contains(fileName))
         return;
 
     // If no one else is tracking this particular unit, we remove it.
@@ -67,16 +80,22 @@ void LiveUnitsManager::cancelTrackingRequest(const QString &fileName)
 
 void LiveUnitsManager::updateUnit(const QString &fileName, const Unit &unit)
 {
-    if (!isTracking(fileName))
-        return;
+    {
+        QMutexLocker locker(&m_mutex);
 
-    m_units[fileName] = unit;
+        if (!m_units.contains(fileName))
+            return;
+
+        m_units[fileName] = unit;
+    }
 
     emit unitAvailable(unit);
 }
 
 Unit LiveUnitsManager::unit(const QString &fileName)
 {
+    QMutexLocker locker(&m_mutex);
+
     return m_units.value(fileName);
 }
 
@@ -37,6 +37,7 @@
 #include <QtCore/QObject>
 #include <QtCore/QString>
 #include <QtCore/QHash>
+#include <QtCore/QMutex>
 
 namespace ClangCodeModel {
 namespace Internal {
@@ -52,8 +53,7 @@ public:
     { return m_instance; }
 
     void requestTracking(const QString &fileName);
-    bool isTracking(const QString &fileName) const
-    { return m_units.contains(fileName); }
+    bool isTracking(const QString &fileName) const;
 
     void cancelTrackingRequest(const QString &fileName);
 
@@ -69,6 +69,8 @@ signals:
 
 private:
     static LiveUnitsManager *m_instance;
+
+    mutable QMutex m_mutex;
     QHash<QString, Unit> m_units;
 };
 
@@ -28,10 +28,13 @@
 ****************************************************************************/
 
 #include "semanticmarker.h"
+#include "sharedunits.h"
 #include "unit.h"
 #include "utils_p.h"
 #include "cxraii.h"
 
+#include <QMutexLocker>
+
 using namespace ClangCodeModel;
 using namespace ClangCodeModel::Internal;
 
@@ -47,50 +50,50 @@ SemanticMarker::~SemanticMarker()
 
 QString SemanticMarker::fileName() const
 {
-    if (!m_unit)
-        return QString();
-
-    return m_unit->fileName();
+    return m_fileName;
 }
 
 void SemanticMarker::setFileName(const QString &fileName)
 {
-    if (this->fileName() == fileName)
+    if (m_fileName == fileName)
         return;
 
     QStringList oldOptions;
     if (m_unit)
         oldOptions = m_unit->compilationOptions();
-    m_unit.reset(new Unit(fileName));
+    m_fileName = fileName;
+    m_unit.reset();
     if (!oldOptions.isEmpty())
-        m_unit->setCompilationOptions(oldOptions);
-
-    unsigned clangOpts = clang_defaultEditingTranslationUnitOptions();
-    clangOpts |= CXTranslationUnit_Incomplete;
-    clangOpts |= CXTranslationUnit_DetailedPreprocessingRecord;
-    clangOpts &= ~CXTranslationUnit_CacheCompletionResults;
-    m_unit->setManagementOptions(clangOpts);
+        setCompilationOptions(oldOptions);
 }
 
+/**
+ * @brief Picks the unit shared with completion for the file and \a options
+ */
 void SemanticMarker::setCompilationOptions(const QStringList &options)
 {
-    Q_ASSERT(m_unit);
+    Q_ASSERT(!m_fileName.isEmpty());
 
-    if (m_unit->compilationOptions() == options)
+    if (m_unit && m_unit->compilationOptions() == options)
         return;
 
-    m_unit->setCompilationOptions(options);
+    m_unit.reset(new Unit(SharedUnits::acquire(m_fileName, options)));
 }
 
 void SemanticMarker::reparse(const UnsavedFiles &unsavedFiles)
 {
     Q_ASSERT(m_unit);
 
+    QMutexLocker lock(m_unit->mutex());
+    if (m_unit->isParsedWith(unsavedFiles))
+        return;
+
     m_unit->setUnsavedFiles(unsavedFiles);
     if (m_unit->isLoaded())
         m_unit->reparse();
     else
         m_unit->parse();
+    SharedUnits::parsed(*m_unit);
 }
 
 /**
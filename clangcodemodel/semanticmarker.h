@@ -82,6 +82,7 @@ public:
 
 private:
     mutable QMutex m_mutex;
+    QString m_fileName;
     QScopedPointer<Internal::Unit> m_unit;
 };
 
@@ -0,0 +1,106 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "sharedclangindex.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QWeakPointer>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+class SharedClangIndexData
+{
+    Q_DISABLE_COPY(SharedClangIndexData)
+
+public:
+    explicit SharedClangIndexData(SharedClangIndex::Usage usage)
+        : m_index(clang_createIndex(/*excludeDeclsFromPCH*/ 1,
+                                    /*displayDiagnostics*/ usage == SharedClangIndex::IndexingUsage))
+    {
+#if defined(CINDEX_VERSION)
+        // Indexing runs behind the editor, it must not compete with highlighting.
+        if (m_index && usage == SharedClangIndex::IndexingUsage)
+            clang_CXIndex_setGlobalOptions(m_index, CXGlobalOpt_ThreadBackgroundPriorityForIndexing);
+#endif
+    }
+
+    ~SharedClangIndexData()
+    {
+        if (m_index)
+            clang_disposeIndex(m_index);
+    }
+
+    CXIndex m_index;
+};
+
+} // Internal
+} // ClangCodeModel
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+QMutex indexesMutex;
+QWeakPointer<SharedClangIndexData> indexes[SharedClangIndex::IndexingUsage + 1];
+
+} // Anonymous
+
+SharedClangIndex::SharedClangIndex()
+{
+}
+
+SharedClangIndex::SharedClangIndex(const QSharedPointer<SharedClangIndexData> &data)
+    : m_data(data)
+{
+}
+
+SharedClangIndex SharedClangIndex::acquire(Usage usage)
+{
+    QMutexLocker locker(&indexesMutex);
+
+    QSharedPointer<SharedClangIndexData> data = indexes[usage].toStrongRef();
+    if (!data) {
+        data = QSharedPointer<SharedClangIndexData>(new SharedClangIndexData(usage));
+        indexes[usage] = data;
+    }
+    return SharedClangIndex(data);
+}
+
+bool SharedClangIndex::isNull() const
+{
+    return !m_data || !m_data->m_index;
+}
+
+CXIndex SharedClangIndex::index() const
+{
+    return m_data ? m_data->m_index : 0;
+}
@@ -0,0 +1,74 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef CLANGCODEMODEL_SHAREDCLANGINDEX_H
+#define CLANGCODEMODEL_SHAREDCLANGINDEX_H
+
+#include <clang-c/Index.h>
+
+#include <QtCore/QSharedPointer>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+class SharedClangIndexData;
+
+/*
+ * A handle to one of the few CXIndex objects all translation units are created in.
+ *
+ * Units of the same usage share an index instead of creating one each. The index is
+ * disposed together with the last handle referring to it, and created again on demand.
+ * Translation units of a shared index may be used from different threads, as long as
+ * each unit is used by one thread at a time.
+ */
+class SharedClangIndex
+{
+public:
+    enum Usage {
+        EditorUsage,    // Highlighting, diagnostics and completion of the edited files
+        IndexingUsage   // Background indexing of the project files
+    };
+
+    SharedClangIndex();
+
+    static SharedClangIndex acquire(Usage usage);
+
+    bool isNull() const;
+    CXIndex index() const;
+
+private:
+    explicit SharedClangIndex(const QSharedPointer<SharedClangIndexData> &data);
+
+    QSharedPointer<SharedClangIndexData> m_data;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // CLANGCODEMODEL_SHAREDCLANGINDEX_H
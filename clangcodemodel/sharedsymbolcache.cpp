@@ -0,0 +1,188 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "sharedsymbolcache.h"
+
+#include <utils/fileutils.h>
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+const quint32 kEntryMagic = 0x0A0BFFEF;
+const quint16 kEntryVersion = 3;
+
+} // Anonymous
+
+SharedSymbolCache::SharedSymbolCache(const QString &directory)
+    : m_directory(directory)
+{
+    QDir().mkpath(m_directory);
+}
+
+SharedSymbolCache::~SharedSymbolCache()
+{
+}
+
+QByteArray SharedSymbolCache::optionsFingerprint(const QStringList &options)
+{
+    // Include paths and the PCH only decide where other files come from, not what a given
+    // header declares. Defines, the language, and the language flags do.
+    QStringList relevant;
+    for (int i = 0, ei = options.size(); i < ei; ++i) {
+        const QString &option = options.at(i);
+        if (option == QLatin1String("-x") && i + 1 < ei) {
+            relevant << option + options.at(++i);
+        } else if (option.startsWith(QLatin1String("-D"))
+                   || option.startsWith(QLatin1String("-U"))
+                   || option.startsWith(QLatin1String("-std="))
+                   || option.startsWith(QLatin1String("-f"))
+                   || option == QLatin1String("-ObjC")
+                   || option == QLatin1String("-ObjC++")) {
+            relevant << option;
+        }
+    }
+    relevant.sort();
+    relevant.removeDuplicates();
+
+    return QCryptographicHash::hash(relevant.join(QLatin1String("\n")).toUtf8(),
+                                    QCryptographicHash::Sha1);
+}
+
+QByteArray SharedSymbolCache::keyFor(const QString &fileName, const QByteArray &optionsFingerprint)
+{
+    const QDateTime lastModified = QFileInfo(fileName).lastModified();
+
+    QByteArray contentHash;
+    {
+        QMutexLocker locker(&m_mutex);
+        const QPair<QDateTime, QByteArray> &known = m_contentHashes.value(fileName);
+        if (known.first.isValid() && known.first == lastModified)
+            contentHash = known.second;
+    }
+
+    if (contentHash.isEmpty()) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+        contentHash = QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha1);
+
+        QMutexLocker locker(&m_mutex);
+        m_contentHashes.insert(fileName, qMakePair(lastModified, contentHash));
+    }
+
+    // Entries of a different format simply get a different key.
+    QByteArray key = contentHash + optionsFingerprint;
+    key += QByteArray::number(kEntryVersion);
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+}
+
+bool SharedSymbolCache::contains(const QByteArray &key) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_knownKeys.contains(key))
+        return true;
+
+    // Another session might have stored it in the meantime.
+    if (QFile::exists(entryPath(key))) {
+        m_knownKeys.insert(key);
+        return true;
+    }
+    return false;
+}
+
+QVector<Symbol> SharedSymbolCache::symbols(const QByteArray &key, const QString &fileName) const
+{
+    QVector<Symbol> symbols;
+
+    ::Utils::FileReader reader;
+    if (!reader.fetch(entryPath(key)))
+        return symbols;
+
+    QDataStream stream(reader.data());
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (magic != kEntryMagic || version != kEntryVersion)
+        return symbols;
+
+    stream.setVersion(QDataStream::Qt_4_7);
+    stream >> symbols;
+
+    for (int i = 0; i < symbols.size(); ++i) {
+        Symbol &symbol = symbols[i];
+        const SourceLocation &loc = symbol.m_location;
+        symbol.m_location = SourceLocation(fileName, loc.line(), loc.column(), loc.offset());
+    }
+
+    return symbols;
+}
+
+void SharedSymbolCache::store(const QByteArray &key, const QVector<Symbol> &symbols)
+{
+    if (key.isEmpty() || contains(key))
+        return;
+
+    QVector<Symbol> anonymous = symbols;
+    for (int i = 0; i < anonymous.size(); ++i) {
+        Symbol &symbol = anonymous[i];
+        const SourceLocation &loc = symbol.m_location;
+        symbol.m_location = SourceLocation(QString(), loc.line(), loc.column(), loc.offset());
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << kEntryMagic << kEntryVersion;
+    stream.setVersion(QDataStream::Qt_4_7);
+    stream << anonymous;
+
+    ::Utils::FileSaver saver(entryPath(key));
+    saver.write(data);
+    if (!saver.finalize()) {
+        qWarning("Failed to store shared symbols for %s", key.constData());
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_knownKeys.insert(key);
+}
+
+QString SharedSymbolCache::entryPath(const QByteArray &key) const
+{
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(key) + QLatin1String(".qcs");
+}
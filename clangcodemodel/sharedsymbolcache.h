@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef SHAREDSYMBOLCACHE_H
+#define SHAREDSYMBOLCACHE_H
+
+#include "symbol.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * A symbol cache shared by all sessions for headers which live outside of the project
+ * roots (Qt, the standard library, Boost, SDKs, ...). Entries are content-addressed: the
+ * key is derived from the header's content and from the options which can change what the
+ * header declares, so an entry never needs to be invalidated and is stored only once on
+ * disk no matter how many sessions or checkouts use it.
+ *
+ * Entries are written atomically and never modified afterwards, which makes it safe for
+ * several Creator instances to share the same directory.
+ *
+ * Notes:
+ *  - Symbols are stored without their file name, which is filled in on retrieval. The same
+ *    header installed in two places therefore maps to a single entry.
+ *  - Headers whose declarations depend on macros defined by the includer (rather than by
+ *    the command line) are not handled specially, this is rarely the case for the kind of
+ *    headers cached here.
+ */
+class SharedSymbolCache
+{
+    Q_DISABLE_COPY(SharedSymbolCache)
+
+public:
+    SharedSymbolCache(const QString &directory);
+    ~SharedSymbolCache();
+
+    QString directory() const
+    { return m_directory; }
+
+    // Reduces the options to the ones affecting the declarations found in a header.
+    static QByteArray optionsFingerprint(const QStringList &options);
+
+    // Returns an empty key if the file cannot be read.
+    QByteArray keyFor(const QString &fileName, const QByteArray &optionsFingerprint);
+
+    bool contains(const QByteArray &key) const;
+    QVector<Symbol> symbols(const QByteArray &key, const QString &fileName) const;
+    void store(const QByteArray &key, const QVector<Symbol> &symbols);
+
+private:
+    QString entryPath(const QByteArray &key) const;
+
+    mutable QMutex m_mutex;
+    QString m_directory;
+    QHash<QString, QPair<QDateTime, QByteArray> > m_contentHashes;
+    mutable QSet<QByteArray> m_knownKeys;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // SHAREDSYMBOLCACHE_H
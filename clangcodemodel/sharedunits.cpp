@@ -0,0 +1,250 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "sharedunits.h"
+
+#include <clang-c/Index.h>
+
+#include <QtCore/QMutexLocker>
+#include <QtAlgorithms>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+SharedUnits *SharedUnits::m_instance = 0;
+
+SharedUnits::SharedUnits()
+    : m_memoryBudget(qint64(DefaultMemoryBudgetMB) * 1024 * 1024)
+    , m_releasedUnits(0)
+{
+    Q_ASSERT(!m_instance);
+    m_instance = this;
+}
+
+SharedUnits::~SharedUnits()
+{
+    m_instance = 0;
+}
+
+Unit SharedUnits::acquire(const QString &fileName, const QStringList &options)
+{
+    if (m_instance)
+        return m_instance->unit(fileName, options);
+    return createUnit(fileName, options);
+}
+
+/**
+ * @brief What highlighting and completion both need from the unit
+ */
+unsigned SharedUnits::managementOptions()
+{
+    unsigned opts = clang_defaultEditingTranslationUnitOptions();
+    opts |= CXTranslationUnit_Incomplete;
+    opts |= CXTranslationUnit_DetailedPreprocessingRecord;
+#if defined(CINDEX_VERSION) && (CINDEX_VERSION > 5)
+    opts |= CXTranslationUnit_CacheCompletionResults;
+    opts |= CXTranslationUnit_IncludeBriefCommentsInCodeCompletion;
+#endif
+    return opts;
+}
+
+void SharedUnits::parsed(const Unit &unit)
+{
+    if (m_instance)
+        m_instance->measure(unit);
+}
+
+Unit SharedUnits::unit(const QString &fileName, const QStringList &options)
+{
+    const Key key(fileName, optionsFingerprint(options));
+
+    QMutexLocker locker(&m_mutex);
+
+    dropUnused();
+
+    QMap<Key, Unit>::const_iterator it = m_units.constFind(key);
+    if (it != m_units.constEnd())
+        return it.value();
+
+    const Unit unit = createUnit(fileName, options);
+    m_units.insert(key, unit);
+    return unit;
+}
+
+void SharedUnits::remove(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QMap<Key, Unit>::iterator it = m_units.begin();
+    while (it != m_units.end()) {
+        if (it.key().first == fileName) {
+            m_memoryUsage.remove(it.key());
+            m_recentlyParsed.removeOne(it.key());
+            it = m_units.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+qint64 SharedUnits::memoryBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_memoryBudget;
+}
+
+void SharedUnits::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_memoryBudget = qMax(bytes, qint64(0));
+    enforceBudget(Key());
+}
+
+qint64 SharedUnits::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 total = 0;
+    foreach (qint64 bytes, m_memoryUsage)
+        total += bytes;
+    return total;
+}
+
+int SharedUnits::releasedUnits() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_releasedUnits;
+}
+
+QString SharedUnits::memoryReport() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 total = 0;
+    QList<QPair<qint64, QString> > units;
+    QMap<Key, qint64>::const_iterator it = m_memoryUsage.constBegin();
+    for (; it != m_memoryUsage.constEnd(); ++it) {
+        total += it.value();
+        units.append(qMakePair(it.value(), it.key().first));
+    }
+    qSort(units.begin(), units.end(), qGreater<QPair<qint64, QString> >());
+
+    QString r;
+    r += QString::fromLatin1("Translation units: %1 shared, %2 loaded, %3 MiB")
+            .arg(m_units.size()).arg(units.size()).arg(total / (1024 * 1024));
+    if (m_memoryBudget > 0)
+        r += QString::fromLatin1(" of %1 MiB budget").arg(m_memoryBudget / (1024 * 1024));
+    r += QString::fromLatin1(", %1 released\n").arg(m_releasedUnits);
+    for (int i = 0; i < units.size(); ++i) {
+        r += QString::fromLatin1("  %1 KiB  %2\n")
+                .arg(units.at(i).first / 1024, 8).arg(units.at(i).second);
+    }
+    return r;
+}
+
+Unit SharedUnits::createUnit(const QString &fileName, const QStringList &options)
+{
+    Unit unit(fileName);
+    unit.setCompilationOptions(options);
+    unit.setManagementOptions(managementOptions());
+    return unit;
+}
+
+// Units only referenced from here belong to closed editors or to outdated options.
+void SharedUnits::dropUnused()
+{
+    QMap<Key, Unit>::iterator it = m_units.begin();
+    while (it != m_units.end()) {
+        if (it.value().isUnique()) {
+            m_memoryUsage.remove(it.key());
+            m_recentlyParsed.removeOne(it.key());
+            it = m_units.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SharedUnits::measure(const Unit &unit)
+{
+    const Key key(unit.fileName(), optionsFingerprint(unit.compilationOptions()));
+    const qint64 bytes = unit.memoryUsage();
+
+    QMutexLocker locker(&m_mutex);
+
+    // Unshared units, e.g. of the indexer, aren't accounted for.
+    if (!m_units.contains(key))
+        return;
+
+    m_recentlyParsed.removeOne(key);
+    if (!unit.isLoaded()) {
+        m_memoryUsage.remove(key);
+        return;
+    }
+
+    m_memoryUsage.insert(key, bytes);
+    m_recentlyParsed.prepend(key);
+    enforceBudget(key);
+}
+
+/**
+ * @brief Unloads the least recently parsed units until the measured total fits the budget
+ * @param kept Never unloaded, it's the unit that was just parsed
+ *
+ * A unit locked by a client right now is skipped, it's still in use.
+ */
+void SharedUnits::enforceBudget(const Key &kept)
+{
+    if (m_memoryBudget <= 0)
+        return;
+
+    qint64 total = 0;
+    foreach (qint64 bytes, m_memoryUsage)
+        total += bytes;
+
+    for (int i = m_recentlyParsed.size() - 1; i >= 0 && total > m_memoryBudget; --i) {
+        const Key key = m_recentlyParsed.at(i);
+        if (key == kept)
+            continue;
+
+        Unit unit = m_units.value(key);
+        QMutex *unitMutex = unit.mutex();
+        if (!unitMutex->tryLock())
+            continue;
+        unit.unload();
+        unitMutex->unlock();
+
+        total -= m_memoryUsage.take(key);
+        m_recentlyParsed.removeAt(i);
+        ++m_releasedUnits;
+    }
+}
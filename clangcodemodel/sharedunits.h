@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef SHAREDUNITS_H
+#define SHAREDUNITS_H
+
+#include "unit.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * The translation units of the files being edited, shared by highlighting, diagnostics
+ * and completion, so each file is parsed once and reparsed once per edit.
+ *
+ * Units are keyed by file name and options fingerprint. A unit is kept as long as some
+ * client holds it; unused units are dropped on the next request. Clients serialize their
+ * access through Unit::mutex(), which is shared along with the unit.
+ *
+ * Clients report each (re)parse with parsed(), which measures the unit. Once the total
+ * exceeds the memory budget, the translation units of the least recently parsed units
+ * are disposed; whoever uses such a unit next parses it again.
+ */
+class SharedUnits
+{
+    Q_DISABLE_COPY(SharedUnits)
+
+public:
+    SharedUnits();
+    ~SharedUnits();
+
+    static SharedUnits *instance()
+    { return m_instance; }
+
+    // Falls back to an unshared unit when there is no instance, e.g. in tests.
+    static Unit acquire(const QString &fileName, const QStringList &options);
+
+    static unsigned managementOptions();
+
+    // To be called with the unit's mutex held, right after it was (re)parsed.
+    static void parsed(const Unit &unit);
+
+    Unit unit(const QString &fileName, const QStringList &options);
+    void remove(const QString &fileName);
+
+    enum { DefaultMemoryBudgetMB = 1024 };
+
+    // In bytes, 0 means unlimited
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+    qint64 memoryUsage() const;
+    int releasedUnits() const;
+    QString memoryReport() const;
+
+private:
+    typedef QPair<QString, QByteArray> Key;
+
+    static Unit createUnit(const QString &fileName, const QStringList &options);
+    void dropUnused();
+    void measure(const Unit &unit);
+    void enforceBudget(const Key &kept);
+
+    static SharedUnits *m_instance;
+
+    mutable QMutex m_mutex;
+    QMap<Key, Unit> m_units;
+    QMap<Key, qint64> m_memoryUsage; // Of the loaded units
+    QList<Key> m_recentlyParsed; // Most recent first, loaded units only
+    qint64 m_memoryBudget;
+    int m_releasedUnits;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // SHAREDUNITS_H
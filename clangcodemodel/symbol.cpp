@@ -35,6 +35,7 @@ using namespace ClangCodeModel;
 
 Symbol::Symbol()
     : m_kind(Unknown)
+    , m_access(Public)
 {}
 
 Symbol::Symbol(const QString &name,
@@ -45,6 +46,7 @@ Symbol::Symbol(const QString &name,
     , m_qualification(qualification)
     , m_location(location)
     , m_kind(type)
+    , m_access(Public)
 {}
 
 QIcon Symbol::iconForSymbol() const
@@ -76,7 +78,9 @@ QDataStream &operator<<(QDataStream &stream, const Symbol &symbol)
            << (quint32)symbol.m_location.line()
            << (quint16)symbol.m_location.column()
            << (quint32)symbol.m_location.offset()
-           << (qint8)symbol.m_kind;
+           << (qint8)symbol.m_kind
+           << symbol.m_baseClasses
+           << (quint8)symbol.m_access;
 
     return stream;
 }
@@ -88,15 +92,19 @@ QDataStream &operator>>(QDataStream &stream, Symbol &symbol)
     quint16 column;
     quint32 offset;
     quint8 kind;
+    quint8 access;
     stream >> symbol.m_name
            >> symbol.m_qualification
            >> fileName
            >> line
            >> column
            >> offset
-           >> kind;
+           >> kind
+           >> symbol.m_baseClasses
+           >> access;
     symbol.m_location = SourceLocation(fileName, line, column, offset);
     symbol.m_kind = Symbol::Kind(kind);
+    symbol.m_access = Symbol::Access(access);
 
     return stream;
 }
@@ -106,7 +114,9 @@ bool operator==(const Symbol &a, const Symbol &b)
     return a.m_name == b.m_name
             && a.m_qualification == b.m_qualification
             && a.m_location == b.m_location
-            && a.m_kind == b.m_kind;
+            && a.m_kind == b.m_kind
+            && a.m_baseClasses == b.m_baseClasses
+            && a.m_access == b.m_access;
 }
 
 bool operator!=(const Symbol &a, const Symbol &b)
@@ -33,6 +33,7 @@
 #include "sourcelocation.h"
 
 #include <QString>
+#include <QStringList>
 #include <QDataStream>
 #include <QIcon>
 
@@ -52,6 +53,12 @@ public:
         Unknown
     };
 
+    enum Access {
+        Public,
+        Protected,
+        Private
+    };
+
     Symbol();
     Symbol(const QString &name,
            const QString &qualification,
@@ -62,6 +69,8 @@ public:
     QString m_qualification;
     SourceLocation m_location;
     Kind m_kind;
+    QStringList m_baseClasses; // Qualified names of the direct base classes.
+    Access m_access; // Of class members, Public for everything else.
 
     QIcon iconForSymbol() const;
 };
@@ -0,0 +1,242 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+/**
+ * @file clangcompletion_benchmark.cpp
+ * @brief Measures code completion latency
+ *
+ * Replays the completion fixtures and a few generated translation units
+ * through ClangCompleter. Cold parse, warm reparse and completion are timed
+ * separately; p95 latencies are checked against completion_benchmark_baseline.txt.
+ *
+ * Takes minutes, so it only runs with QTC_CLANG_BENCHMARK set.
+ */
+
+#ifdef WITH_TESTS
+
+#include <QtTest>
+#include <QDebug>
+#include <QElapsedTimer>
+#undef interface // Canceling "#DEFINE interface struct" on Windows
+
+#include "completiontesthelper.h"
+#include "../clangcodemodelplugin.h"
+
+#include <algorithm>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+enum { ColdRuns = 5, WarmRuns = 10 };
+
+class LatencySamples
+{
+public:
+    void add(qint64 msecs)
+    { m_samples.append(msecs); }
+
+    // Nearest-rank percentile
+    qint64 percentile(int p) const
+    {
+        if (m_samples.isEmpty())
+            return 0;
+        QList<qint64> sorted = m_samples;
+        std::sort(sorted.begin(), sorted.end());
+        const int rank = (p * sorted.size() + 99) / 100;
+        return sorted.at(qBound(0, rank - 1, sorted.size() - 1));
+    }
+
+    qint64 total() const
+    {
+        qint64 sum = 0;
+        foreach (qint64 sample, m_samples)
+            sum += sample;
+        return sum;
+    }
+
+private:
+    QList<qint64> m_samples;
+};
+
+struct LatencyLimits
+{
+    LatencyLimits() : coldParse(0), warmReparse(0), completion(0) {}
+
+    qint64 coldParse;
+    qint64 warmReparse;
+    qint64 completion;
+};
+
+LatencyLimits latencyLimits(const QString &tag)
+{
+    QFile file(QLatin1String(":/unittests/ClangCodeModel/completion_benchmark_baseline.txt"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return LatencyLimits();
+
+    bool ok = false;
+    double scale = qgetenv("QTC_CLANG_BENCHMARK_SCALE").toDouble(&ok);
+    if (!ok || scale <= 0)
+        scale = 1;
+
+    LatencyLimits fallback;
+    LatencyLimits own;
+    bool hasOwn = false;
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+            continue;
+        const QStringList fields = line.split(QRegExp(QLatin1String("\\s+")));
+        if (fields.size() != 4)
+            continue;
+
+        LatencyLimits limits;
+        limits.coldParse = qint64(fields.at(1).toLongLong() * scale);
+        limits.warmReparse = qint64(fields.at(2).toLongLong() * scale);
+        limits.completion = qint64(fields.at(3).toLongLong() * scale);
+        if (fields.at(0) == QLatin1String("*")) {
+            fallback = limits;
+        } else if (fields.at(0) == tag) {
+            own = limits;
+            hasOwn = true;
+        }
+    }
+    return hasOwn ? own : fallback;
+}
+
+/**
+ * @brief Generates a translation unit with @a classCount classes and an
+ * unqualified completion request inside a function body
+ */
+QByteArray generatedSource(int classCount)
+{
+    QByteArray source;
+    for (int i = 0; i < classCount; ++i) {
+        const QByteArray n = QByteArray::number(i);
+        source += "class Generated" + n + "\n{\npublic:\n";
+        for (int m = 0; m < 8; ++m) {
+            const QByteArray k = QByteArray::number(m);
+            source += "    int method" + k + "(int a, const char *b) const;\n";
+        }
+        source += "    int m_value" + n + ";\n};\n\n";
+        source += "int generatedFunction" + n + "(Generated" + n + " *object);\n\n";
+    }
+    source += "int main()\n{\n    <<<<\n}\n";
+    return source;
+}
+
+void report(const char *phase, const LatencySamples &samples, int runs, int results)
+{
+    const qint64 total = samples.total();
+    const double resultsPerSecond = total > 0 ? (1000.0 * results * runs) / total : 0;
+    qDebug("%-12s p50 %5lld ms  p95 %5lld ms  %10.0f results/s",
+           phase,
+           static_cast<long long>(samples.percentile(50)),
+           static_cast<long long>(samples.percentile(95)),
+           resultsPerSecond);
+}
+
+} // Anonymous
+
+void ClangCodeModelPlugin::test_CXX_completionBenchmark()
+{
+    if (qgetenv("QTC_CLANG_BENCHMARK").isEmpty())
+        CLANG_SKIP_TEST("Set QTC_CLANG_BENCHMARK to run the completion benchmark.");
+
+    QFETCH(QString, file);
+    QFETCH(int, generatedClasses);
+
+    CompletionTestHelper helper;
+    if (generatedClasses > 0) {
+        helper.setSource(generatedSource(generatedClasses));
+    } else {
+        helper << file;
+    }
+
+    LatencySamples coldParse;
+    QElapsedTimer timer;
+    for (int i = 0; i < ColdRuns; ++i) {
+        helper.unload();
+        timer.start();
+        QVERIFY(helper.reparse());
+        coldParse.add(timer.elapsed());
+    }
+
+    // Reparsing unchanged contents is a no-op, so every run edits the end of the file
+    LatencySamples warmReparse;
+    for (int i = 0; i < WarmRuns; ++i) {
+        helper.setUnsavedSource(helper.source() + "\n// edit " + QByteArray::number(i) + '\n');
+        timer.start();
+        QVERIFY(helper.reparse());
+        warmReparse.add(timer.elapsed());
+    }
+
+    LatencySamples completion;
+    int results = 0;
+    for (int i = 0; i < WarmRuns; ++i) {
+        timer.start();
+        results = helper.codeComplete().size();
+        completion.add(timer.elapsed());
+    }
+    QVERIFY(results > 0);
+
+    report("cold parse", coldParse, ColdRuns, 0);
+    report("reparse", warmReparse, WarmRuns, 0);
+    report("completion", completion, WarmRuns, results);
+
+    const LatencyLimits limits = latencyLimits(QString::fromLatin1(QTest::currentDataTag()));
+    if (limits.coldParse > 0)
+        QVERIFY2(coldParse.percentile(95) <= limits.coldParse, "cold parse p95 exceeds baseline");
+    if (limits.warmReparse > 0)
+        QVERIFY2(warmReparse.percentile(95) <= limits.warmReparse, "reparse p95 exceeds baseline");
+    if (limits.completion > 0)
+        QVERIFY2(completion.percentile(95) <= limits.completion, "completion p95 exceeds baseline");
+}
+
+void ClangCodeModelPlugin::test_CXX_completionBenchmark_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::addColumn<int>("generatedClasses");
+
+    const char *fixtures[] = {
+        "cxx_regression_1.cpp", "cxx_regression_2.cpp", "cxx_regression_3.cpp",
+        "cxx_regression_4.cpp", "cxx_regression_5.cpp", "cxx_regression_6.cpp",
+        "cxx_regression_7.cpp", "cxx_regression_8.cpp", "cxx_regression_9.cpp",
+        "cxx_snippets_1.cpp", "cxx_snippets_2.cpp", "cxx_snippets_3.cpp",
+        "cxx_snippets_4.cpp"
+    };
+    for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); ++i)
+        QTest::newRow(fixtures[i]) << QString::fromLatin1(fixtures[i]) << 0;
+
+    QTest::newRow("generated_200") << QString() << 200;
+    QTest::newRow("generated_1000") << QString() << 1000;
+}
+
+#endif
@@ -42,10 +42,21 @@
 
 #include <QtTest>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTemporaryFile>
 #undef interface // Canceling "#DEFINE interface struct" on Windows
 
 #include "completiontesthelper.h"
 #include "../clangcodemodelplugin.h"
+#include "../completionservice.h"
+#include "../globalcompletioncache.h"
+#include "../index.h"
+#include "../indexer.h"
+#include "../sharedunits.h"
+#include "../unit.h"
 
 using namespace ClangCodeModel;
 using namespace ClangCodeModel::Internal;
@@ -389,4 +400,421 @@ void ClangCodeModelPlugin::test_ObjC_hints_data()
     hints.clear();
 }
 
+/**
+ * \defgroup Global completion cache
+ *
+ * Results from the PCH and the preamble survive the session, until a header changes.
+ *
+ * @{
+ */
+
+void ClangCodeModelPlugin::test_globalCompletionCache()
+{
+    const QString directory = QDir::tempPath()
+            + QString::fromLatin1("/qtc-clang-global-completion-%1")
+              .arg(QCoreApplication::applicationPid());
+    QTemporaryFile header;
+    QVERIFY(header.open());
+    header.write("int global(int);\n");
+    header.flush();
+
+    CodeCompletionResult local(10);
+    local.setText(QLatin1String("local"));
+    local.setCompletionKind(CodeCompletionResult::VariableCompletionKind);
+    CodeCompletionResult global(20);
+    global.setText(QLatin1String("global"));
+    global.setHint(QLatin1String("int global(int)"));
+    global.setCompletionKind(CodeCompletionResult::FunctionCompletionKind);
+    global.setHasParameters(true);
+
+    const QList<CodeCompletionResult> globals = GlobalCompletionCache::difference(
+                QList<CodeCompletionResult>() << local << global,
+                QList<CodeCompletionResult>() << local);
+    QCOMPARE(globals.size(), 1);
+    QVERIFY(globals.first() == global);
+
+    // The PCH is rebuilt under another name in every session.
+    const QStringList includes = QStringList() << header.fileName();
+    const QByteArray key = GlobalCompletionCache::key(
+                QByteArray(), QStringList() << QLatin1String("-include-pch")
+                << QLatin1String("/tmp/session1.pch"), includes, QByteArray());
+    QCOMPARE(key, GlobalCompletionCache::key(
+                 QByteArray(), QStringList() << QLatin1String("-include-pch")
+                 << QLatin1String("/tmp/session2.pch"), includes, QByteArray()));
+
+    {
+        GlobalCompletionCache previousSession(directory);
+        previousSession.insert(key, includes, globals);
+    }
+
+    QList<CodeCompletionResult> results;
+    GlobalCompletionCache cache(directory);
+    QVERIFY(cache.lookup(key, &results));
+    QCOMPARE(results.size(), 1);
+    QVERIFY(results.first() == global);
+    QCOMPARE(results.first().hint(), global.hint());
+    QCOMPARE(results.first().priority(), global.priority());
+
+    header.remove();
+    GlobalCompletionCache nextSession(directory);
+    QVERIFY(!nextSession.lookup(key, &results));
+
+    QDir dir(directory);
+    foreach (const QString &entry, dir.entryList(QDir::Files))
+        dir.remove(entry);
+    QDir().rmdir(directory);
+}
+
+/**
+ * \defgroup Indexed members
+ *
+ * Member completion shows the indexed methods while libclang is busy.
+ *
+ * @{
+ */
+
+void ClangCodeModelPlugin::test_indexedMembers()
+{
+    const QString fileName = QLatin1String("/tmp/members.h");
+    Symbol base(QLatin1String("Base"), QLatin1String("ns::Base"), Symbol::Class,
+                SourceLocation(fileName, 1, 1));
+    Symbol baseMethod(QLatin1String("inherited"), QLatin1String("ns::Base::inherited"),
+                      Symbol::Method, SourceLocation(fileName, 2, 5));
+    Symbol derived(QLatin1String("Derived"), QLatin1String("ns::Derived"), Symbol::Class,
+                   SourceLocation(fileName, 4, 1));
+    derived.m_baseClasses << QLatin1String("ns::Base");
+    Symbol derivedMethod(QLatin1String("own"), QLatin1String("ns::Derived::own"),
+                         Symbol::Method, SourceLocation(fileName, 5, 5));
+
+    Index index;
+    index.replaceFile(fileName, QVector<Symbol>() << base << baseMethod << derived
+                      << derivedMethod, QDateTime::currentDateTime());
+
+    QList<Symbol> members = index.members(QLatin1String("ns::Derived"));
+    QCOMPARE(members.size(), 2);
+    QVERIFY(members.contains(derivedMethod));
+    QVERIFY(members.contains(baseMethod));
+
+    members = index.members(QLatin1String("ns::Base"));
+    QCOMPARE(members.size(), 1);
+    QVERIFY(members.contains(baseMethod));
+
+    index.replaceFile(fileName, QVector<Symbol>() << base << baseMethod,
+                      QDateTime::currentDateTime());
+    QVERIFY(index.members(QLatin1String("ns::Derived")).isEmpty());
+}
+
+/**
+ * \defgroup Class hierarchy
+ *
+ * Base classes and the access of members are recorded while indexing, by the same
+ * qualified names the symbols get, and survive the index being saved and loaded again.
+ *
+ * @{
+ */
+
+namespace {
+
+QStringList qualifications(const QList<Symbol> &symbols)
+{
+    QStringList names;
+    foreach (const Symbol &symbol, symbols)
+        names << symbol.m_qualification;
+    names.sort();
+    return names;
+}
+
+Symbol classSymbol(const QList<Symbol> &symbols, const QString &qualification,
+                   Symbol::Kind kind = Symbol::Class)
+{
+    foreach (const Symbol &symbol, symbols) {
+        if (symbol.m_kind == kind && symbol.m_qualification == qualification)
+            return symbol;
+    }
+    return Symbol();
+}
+
+} // Anonymous
+
+void ClangCodeModelPlugin::test_classHierarchy()
+{
+    const QString fileName = QDir::tempPath() + QLatin1String("/hierarchy.cpp");
+    QFile source(fileName);
+    QVERIFY(source.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    source.write("namespace ns {\n"
+                 "class Base { public: void inherited(); protected: void shielded();"
+                 " private: void hidden(); };\n"
+                 "class Derived : public Base { public: void own(); };\n"
+                 "}\n"
+                 "class MoreDerived : public ns::Derived {};\n"
+                 "class Unrelated {};\n");
+    source.close();
+
+    Unit unit(fileName);
+    unit.setCompilationOptions(QStringList() << QLatin1String("-x")
+                               << QLatin1String("c++"));
+    unit.parse();
+    QVERIFY(unit.isLoaded());
+
+    Indexer indexer;
+    indexer.runQuickIndexing(unit, CppTools::ProjectPart::Ptr(new CppTools::ProjectPart));
+    for (int waited = 0; waited < 10000 && indexer.classesFromFile(fileName).size() < 4;
+         waited += 50) {
+        QTest::qWait(50);
+    }
+    QCOMPARE(indexer.classesFromFile(fileName).size(), 4);
+
+    const QList<Symbol> symbols = indexer.allFromFile(fileName);
+    QCOMPARE(classSymbol(symbols, QLatin1String("ns::Derived")).m_baseClasses,
+             QStringList() << QLatin1String("ns::Base"));
+    QCOMPARE(classSymbol(symbols, QLatin1String("MoreDerived")).m_baseClasses,
+             QStringList() << QLatin1String("ns::Derived"));
+    QVERIFY(classSymbol(symbols, QLatin1String("Unrelated")).m_baseClasses.isEmpty());
+
+    const QString shielded = QLatin1String("ns::Base::shielded");
+    const QString hidden = QLatin1String("ns::Base::hidden");
+    QCOMPARE(classSymbol(symbols, QLatin1String("ns::Base::inherited"), Symbol::Method).m_access,
+             Symbol::Public);
+    QCOMPARE(classSymbol(symbols, shielded, Symbol::Method).m_access, Symbol::Protected);
+    QCOMPARE(classSymbol(symbols, hidden, Symbol::Method).m_access, Symbol::Private);
+
+    const QStringList derivedFromBase = QStringList() << QLatin1String("MoreDerived")
+                                                      << QLatin1String("ns::Derived");
+    QCOMPARE(qualifications(indexer.derivedClasses(QLatin1String("ns::Base"))),
+             derivedFromBase);
+    QCOMPARE(qualifications(indexer.derivedClasses(QLatin1String("ns::Derived"))),
+             QStringList() << QLatin1String("MoreDerived"));
+    QVERIFY(indexer.derivedClasses(QLatin1String("Unrelated")).isEmpty());
+
+    Index index;
+    index.replaceFile(fileName, symbols.toVector(), unit.timeStamp());
+    const QByteArray data = index.serialize();
+
+    Index restored;
+    restored.deserialize(data);
+    QCOMPARE(restored.symbols(fileName).size(), symbols.size());
+    foreach (const Symbol &symbol, restored.symbols(fileName, Symbol::Class)) {
+        QCOMPARE(symbol.m_baseClasses,
+                 classSymbol(symbols, symbol.m_qualification).m_baseClasses);
+    }
+    QCOMPARE(qualifications(restored.derivedClasses(QLatin1String("ns::Base"))),
+             derivedFromBase);
+    QCOMPARE(qualifications(restored.derivedClasses(QLatin1String("ns::Base"), false)),
+             QStringList() << QLatin1String("ns::Derived"));
+    const QList<Symbol> restoredSymbols = restored.symbols(fileName);
+    QCOMPARE(classSymbol(restoredSymbols, shielded, Symbol::Method).m_access, Symbol::Protected);
+    QCOMPARE(classSymbol(restoredSymbols, hidden, Symbol::Method).m_access, Symbol::Private);
+
+    // Indexes of an older version lack the hierarchy, they are dropped.
+    QByteArray older = data;
+    older[5] = 2;
+    Index dropped;
+    dropped.deserialize(older);
+    QVERIFY(dropped.files().isEmpty());
+
+    QFile::remove(fileName);
+}
+
+/**
+ * \defgroup Warm-up
+ *
+ * The initial parse doesn't build the preamble, warming up must really reparse.
+ *
+ * @{
+ */
+
+void ClangCodeModelPlugin::test_warmUp()
+{
+    CompletionTestHelper helper;
+    helper << QLatin1String("cxx_snippets_1.cpp");
+    helper.unload();
+
+    QVERIFY(helper.reparse());
+    QVERIFY(!helper.isWarm());
+
+    // Unchanged contents, so this one is skipped
+    QVERIFY(helper.reparse());
+    QVERIFY(!helper.isWarm());
+
+    QVERIFY(helper.warmUp());
+    QVERIFY(helper.isWarm());
+    QVERIFY(!helper.codeCompleteTexts().isEmpty());
+
+    helper.unload();
+    QVERIFY(!helper.isWarm());
+    QVERIFY(helper.warmUp());
+    QVERIFY(helper.isWarm());
+}
+
+/**
+ * \defgroup Memory budget
+ *
+ * Units parsed by the editors are measured, the least recently parsed are unloaded once
+ * they don't fit the budget anymore.
+ *
+ * @{
+ */
+
+void ClangCodeModelPlugin::test_unitsMemoryBudget()
+{
+    SharedUnits *sharedUnits = SharedUnits::instance();
+    QVERIFY(sharedUnits);
+    const qint64 previousBudget = sharedUnits->memoryBudget();
+    const int previouslyReleased = sharedUnits->releasedUnits();
+
+    const QStringList options = QStringList() << QLatin1String("-x") << QLatin1String("c++");
+    QList<Unit> units;
+    for (int i = 0; i < 2; ++i) {
+        const QString fileName = QDir::tempPath()
+                + QString::fromLatin1("/budget%1.cpp").arg(i);
+        QFile source(fileName);
+        QVERIFY(source.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        source.write("struct S { int member; };\n");
+        source.close();
+
+        units << SharedUnits::acquire(fileName, options);
+    }
+
+    sharedUnits->setMemoryBudget(0);
+    foreach (Unit unit, units) {
+        QMutexLocker lock(unit.mutex());
+        unit.parse();
+        SharedUnits::parsed(unit);
+        QVERIFY(unit.isLoaded());
+    }
+    QVERIFY(sharedUnits->memoryUsage() > 0);
+
+    // Only the unit parsed last stays loaded.
+    qint64 lastUnitBytes = 0;
+    {
+        Unit unit = units.at(1);
+        QMutexLocker lock(unit.mutex());
+        lastUnitBytes = unit.memoryUsage();
+    }
+    sharedUnits->setMemoryBudget(lastUnitBytes);
+    QVERIFY(!units.at(0).isLoaded());
+    QVERIFY(units.at(1).isLoaded());
+    QCOMPARE(sharedUnits->releasedUnits(), previouslyReleased + 1);
+
+    {
+        // Whoever needs the unit parses it again, and the other one makes room.
+        Unit unit = units.at(0);
+        QMutexLocker lock(unit.mutex());
+        unit.parse();
+        SharedUnits::parsed(unit);
+    }
+    QVERIFY(units.at(0).isLoaded());
+    QVERIFY(!units.at(1).isLoaded());
+    QCOMPARE(sharedUnits->releasedUnits(), previouslyReleased + 2);
+
+    sharedUnits->setMemoryBudget(previousBudget);
+    foreach (const Unit &unit, units) {
+        sharedUnits->remove(unit.fileName());
+        QFile::remove(unit.fileName());
+    }
+}
+
+/**
+ * \defgroup Completion service
+ *
+ * Completes in the backend process. The service doesn't complete from its own thread,
+ * which it would block, so the requests come from another one, as from the completion
+ * threads of the editor.
+ *
+ * @{
+ */
+
+namespace {
+
+class ServiceClient : public QThread
+{
+public:
+    ServiceClient(CompletionService *service, const CompletionServiceRequest &request)
+        : m_service(service), m_request(request), m_answered(false)
+    {}
+
+    void run()
+    { m_answered = m_service->complete(m_request, &m_results); }
+
+    // Keeps the service's thread, i.e. this one, talking to the backend meanwhile.
+    bool completeInBackend()
+    {
+        start();
+        while (!isFinished())
+            QTest::qWait(20);
+        wait();
+        return m_answered;
+    }
+
+    QStringList texts() const
+    {
+        QStringList texts;
+        foreach (const CodeCompletionResult &ccr, m_results)
+            texts << ccr.text();
+        return texts;
+    }
+
+private:
+    CompletionService *m_service;
+    CompletionServiceRequest m_request;
+    bool m_answered;
+    QList<CodeCompletionResult> m_results;
+};
+
+} // Anonymous
+
+void ClangCodeModelPlugin::test_completionService()
+{
+    const QString backendPath = CompletionService::defaultBackendPath();
+    if (!QFileInfo(backendPath).isExecutable())
+        CLANG_SKIP_TEST("The completion backend isn't built.");
+
+    const QString fileName = QDir::tempPath() + QLatin1String("/service.cpp");
+    QFile source(fileName);
+    QVERIFY(source.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    source.write("struct Service { int onDisk; };\n"
+                 "void f(Service s)\n"
+                 "{\n"
+                 "    s.\n"
+                 "}\n");
+    source.close();
+
+    CompletionService service(backendPath);
+    QVERIFY(service.isAvailable());
+    service.setTimeout(30000); // Parsing may take a while on a loaded machine
+
+    CompletionServiceRequest request;
+    request.m_fileName = fileName;
+    request.m_options = QStringList() << QLatin1String("-x") << QLatin1String("c++");
+    request.m_line = 4;
+    request.m_column = 7;
+
+    ServiceClient fromDisk(&service, request);
+    QVERIFY(fromDisk.completeInBackend());
+    QVERIFY(fromDisk.texts().contains(QLatin1String("onDisk")));
+
+    // The editor's contents win over the file's.
+    request.m_unsavedFiles.insert(fileName, "struct Service { int edited; };\n"
+                                            "void f(Service s)\n"
+                                            "{\n"
+                                            "    s.\n"
+                                            "}\n");
+    ServiceClient edited(&service, request);
+    QVERIFY(edited.completeInBackend());
+    QVERIFY(edited.texts().contains(QLatin1String("edited")));
+    QVERIFY(!edited.texts().contains(QLatin1String("onDisk")));
+
+    // Sent once, the backend keeps the buffer until a request no longer has it.
+    ServiceClient unchanged(&service, request);
+    QVERIFY(unchanged.completeInBackend());
+    QVERIFY(unchanged.texts().contains(QLatin1String("edited")));
+
+    request.m_unsavedFiles.clear();
+    ServiceClient saved(&service, request);
+    QVERIFY(saved.completeInBackend());
+    QVERIFY(saved.texts().contains(QLatin1String("onDisk")));
+
+    QFile::remove(fileName);
+}
+
 #endif
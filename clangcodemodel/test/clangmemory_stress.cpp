@@ -0,0 +1,193 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+/**
+ * @file clangmemory_stress.cpp
+ * @brief Watches memory growth while editing
+ *
+ * Drives ClangCompleter and SemanticMarker through many simulated edits,
+ * reparses, completions and highlighting passes over the completion fixtures.
+ * The process RSS and the memory libclang reports for the translation unit are
+ * sampled on the way, and must not grow beyond a factor of what they were once
+ * the unit settled.
+ *
+ * Takes long, so it only runs with QTC_CLANG_STRESS_EDITS set, to the number
+ * of edits (1000 if it isn't a number, at least 2). QTC_CLANG_STRESS_GROWTH
+ * sets the allowed growth factor (default 1.5).
+ */
+
+#ifdef WITH_TESTS
+
+#include <QtTest>
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#undef interface // Canceling "#DEFINE interface struct" on Windows
+
+#include "completiontesthelper.h"
+#include "../clangcodemodelplugin.h"
+#include "../semanticmarker.h"
+#include "../unit.h"
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+
+namespace {
+
+enum { DefaultEdits = 1000, MinEdits = 2, SampleInterval = 100 };
+
+// At least one edit past the settled one, which the growth is measured against
+int editCount()
+{
+    bool ok = false;
+    const int edits = qgetenv("QTC_CLANG_STRESS_EDITS").toInt(&ok);
+    return ok ? qMax(edits, int(MinEdits)) : int(DefaultEdits);
+}
+
+double allowedGrowth()
+{
+    bool ok = false;
+    const double growth = qgetenv("QTC_CLANG_STRESS_GROWTH").toDouble(&ok);
+    return ok && growth > 1 ? growth : 1.5;
+}
+
+/**
+ * @brief Resident set size of this process in bytes, or -1 where unknown
+ */
+qint64 residentSetSize()
+{
+#ifdef Q_OS_LINUX
+    QFile status(QLatin1String("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+    while (!status.atEnd()) {
+        const QByteArray line = status.readLine();
+        if (line.startsWith("VmRSS:")) {
+            const QList<QByteArray> fields = line.simplified().split(' ');
+            if (fields.size() >= 2)
+                return fields.at(1).toLongLong() * 1024;
+        }
+    }
+#endif
+    return -1;
+}
+
+qint64 unitMemory(const SemanticMarker &marker)
+{
+    Unit unit = marker.unit();
+    QMutexLocker lock(unit.mutex());
+    return unit.memoryUsage();
+}
+
+QByteArray editedSource(const QByteArray &source, int edit)
+{
+    const QByteArray n = QByteArray::number(edit);
+    return source + "\n// edit " + n + "\nstatic int stressed" + QByteArray::number(edit % 7)
+            + " = " + n + ";\n";
+}
+
+void report(int edit, qint64 rss, qint64 unitBytes)
+{
+    qDebug("edit %5d  rss %8lld kB  unit %8lld kB",
+           edit,
+           static_cast<long long>(rss / 1024),
+           static_cast<long long>(unitBytes / 1024));
+}
+
+} // Anonymous
+
+void ClangCodeModelPlugin::test_CXX_memoryGrowth()
+{
+    QFETCH(QString, file);
+
+    if (qgetenv("QTC_CLANG_STRESS_EDITS").isEmpty())
+        CLANG_SKIP_TEST("Set QTC_CLANG_STRESS_EDITS to run the memory stress test.");
+
+    CompletionTestHelper helper;
+    helper << file;
+
+    // Highlighting shares the unit with completion, as in the editor
+    SemanticMarker marker;
+    marker.setFileName(helper.fileName());
+    marker.setCompilationOptions(helper.options());
+
+    const int edits = editCount();
+    const int settled = qMax(edits / 10, 1);
+    QVERIFY(settled < edits);
+    const unsigned lineCount = helper.source().count('\n') + 1;
+
+    qint64 rssBaseline = -1;
+    qint64 unitBaseline = 0;
+    qint64 rss = -1;
+    qint64 unitBytes = 0;
+    for (int edit = 0; edit < edits; ++edit) {
+        helper.setUnsavedSource(editedSource(helper.source(), edit));
+
+        // Alternate between the highlighting and the completion reparse
+        if (edit % 2)
+            QVERIFY(helper.reparse());
+        else
+            marker.reparse(helper.unsavedFiles());
+
+        QVERIFY(!helper.codeComplete().isEmpty());
+        marker.sourceMarkersInRange(1, lineCount);
+        marker.diagnostics();
+
+        if (edit + 1 == settled) {
+            rssBaseline = residentSetSize();
+            unitBaseline = unitMemory(marker);
+            report(edit + 1, rssBaseline, unitBaseline);
+        } else if ((edit + 1) % SampleInterval == 0 || edit + 1 == edits) {
+            // The last edit is always sampled, it is what the growth is checked on
+            rss = residentSetSize();
+            unitBytes = unitMemory(marker);
+            report(edit + 1, rss, unitBytes);
+        }
+    }
+
+    const double growth = allowedGrowth();
+    QVERIFY(unitBaseline > 0);
+    QVERIFY(unitBytes > 0);
+    QVERIFY2(unitBytes <= unitBaseline * growth, "libclang memory of the unit keeps growing");
+    if (rssBaseline > 0 && rss > 0)
+        QVERIFY2(rss <= rssBaseline * growth, "process memory keeps growing");
+}
+
+void ClangCodeModelPlugin::test_CXX_memoryGrowth_data()
+{
+    QTest::addColumn<QString>("file");
+
+    const char *fixtures[] = {
+        "cxx_regression_1.cpp", "cxx_regression_5.cpp", "cxx_snippets_2.cpp"
+    };
+    for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); ++i)
+        QTest::newRow(fixtures[i]) << QString::fromLatin1(fixtures[i]);
+}
+
+#endif
@@ -33,6 +33,7 @@
 #include "../clangcompletion.h"
 #include "../clangcompleter.h"
 #include "../clangcodemodelplugin.h"
+#include "../sharedunits.h"
 
 #include <cpptools/cppcompletionassist.h>
 
@@ -75,7 +76,12 @@ CompletionTestHelper::~CompletionTestHelper()
 void CompletionTestHelper::operator <<(const QString &fileName)
 {
     QResource res(QLatin1String(":/unittests/ClangCodeModel/") + fileName);
-    m_sourceCode = QByteArray(reinterpret_cast<const char*>(res.data()), res.size());
+    setSource(QByteArray(reinterpret_cast<const char*>(res.data()), res.size()));
+}
+
+void CompletionTestHelper::setSource(const QByteArray &sourceCode)
+{
+    m_sourceCode = sourceCode;
     findCompletionPos();
 
     QString path = QDir::tempPath() + QLatin1String("/file.h");
@@ -103,6 +109,42 @@ QList<CodeCompletionResult> CompletionTestHelper::codeComplete()
     return m_completer->codeCompleteAt(m_line, m_column, m_unsavedFiles);
 }
 
+bool CompletionTestHelper::reparse()
+{
+    return m_completer->reparse(m_unsavedFiles);
+}
+
+bool CompletionTestHelper::warmUp()
+{
+    return m_completer->warmUp(m_unsavedFiles);
+}
+
+bool CompletionTestHelper::isWarm() const
+{
+    return m_completer->isWarm();
+}
+
+/**
+ * @brief Drops the parsed translation unit, so the next request parses from scratch
+ */
+void CompletionTestHelper::unload()
+{
+    const QString fileName = m_completer->fileName();
+    if (SharedUnits *sharedUnits = SharedUnits::instance())
+        sharedUnits->remove(fileName);
+    m_completer = ClangCompleter::Ptr(new ClangCompleter());
+    m_completer->setFileName(fileName);
+    m_completer->setOptions(m_clangOptions);
+}
+
+/**
+ * @brief Simulates an edit: the file is parsed with \a sourceCode instead of its contents
+ */
+void CompletionTestHelper::setUnsavedSource(const QByteArray &sourceCode)
+{
+    m_unsavedFiles.insert(m_completer->fileName(), sourceCode);
+}
+
 int CompletionTestHelper::position() const
 {
     return m_position;
@@ -113,6 +155,21 @@ const QByteArray &CompletionTestHelper::source() const
     return m_sourceCode;
 }
 
+QString CompletionTestHelper::fileName() const
+{
+    return m_completer->fileName();
+}
+
+const QStringList &CompletionTestHelper::options() const
+{
+    return m_clangOptions;
+}
+
+const UnsavedFiles &CompletionTestHelper::unsavedFiles() const
+{
+    return m_unsavedFiles;
+}
+
 void CompletionTestHelper::addOption(const QString &option)
 {
     m_clangOptions << option;
@@ -40,6 +40,13 @@
 
 namespace TextEditor { class IAssistProposal; }
 
+// Skips the rest of the test, QSKIP lost its mode argument with Qt 5
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#  define CLANG_SKIP_TEST(message) QSKIP(message)
+#else
+#  define CLANG_SKIP_TEST(message) QSKIP(message, SkipAll)
+#endif
+
 namespace ClangCodeModel {
 namespace Internal {
 
@@ -51,11 +58,21 @@ public:
     ~CompletionTestHelper();
 
     void operator <<(const QString &fileName);
+    void setSource(const QByteArray &sourceCode);
     QStringList codeCompleteTexts();
     QList<CodeCompletionResult> codeComplete();
 
+    bool reparse();
+    bool warmUp();
+    bool isWarm() const;
+    void unload();
+    void setUnsavedSource(const QByteArray &sourceCode);
+
     int position() const;
     const QByteArray &source() const;
+    QString fileName() const;
+    const QStringList &options() const;
+    const UnsavedFiles &unsavedFiles() const;
 
     void addOption(const QString &option);
 
@@ -28,6 +28,7 @@
 ****************************************************************************/
 
 #include "unit.h"
+#include "sharedclangindex.h"
 #include "unsavedfiledata.h"
 #include "utils_p.h"
 #include "raii/scopedclangoptions.h"
@@ -63,13 +64,16 @@ public:
 
     void updateTimeStamp();
 
-    CXIndex m_index;
+    QMutex m_mutex;
+    SharedClangIndex m_index;
     CXTranslationUnit m_tu;
     QByteArray m_fileName;
     QStringList m_compOptions;
     SharedClangOptions m_sharedCompOptions;
     unsigned m_managementOptions;
     UnsavedFiles m_unsaved;
+    UnsavedFiles m_parsedUnsaved;
+    bool m_isPrimed;
     QDateTime m_timeStamp;
 };
 
@@ -80,25 +84,26 @@ using namespace ClangCodeModel;
 using namespace ClangCodeModel::Internal;
 
 UnitData::UnitData()
-    : m_index(0)
+    : m_mutex(QMutex::Recursive)
     , m_tu(0)
     , m_managementOptions(0)
+    , m_isPrimed(false)
 {
 }
 
 UnitData::UnitData(const QString &fileName)
-    : m_index(clang_createIndex(/*excludeDeclsFromPCH*/ 1, /*displayDiagnostics*/ 0))
+    : m_mutex(QMutex::Recursive)
+    , m_index(SharedClangIndex::acquire(SharedClangIndex::EditorUsage))
     , m_tu(0)
     , m_fileName(fileName.toUtf8())
     , m_managementOptions(0)
+    , m_isPrimed(false)
 {
 }
 
 UnitData::~UnitData()
 {
     unload();
-    clang_disposeIndex(m_index);
-    m_index = 0;
 }
 
 void UnitData::swap(UnitData *other)
@@ -110,6 +115,8 @@ void UnitData::swap(UnitData *other)
     qSwap(m_sharedCompOptions, other->m_sharedCompOptions);
     qSwap(m_managementOptions, other->m_managementOptions);
     qSwap(m_unsaved, other->m_unsaved);
+    qSwap(m_parsedUnsaved, other->m_parsedUnsaved);
+    qSwap(m_isPrimed, other->m_isPrimed);
     qSwap(m_timeStamp, other->m_timeStamp);
 }
 
@@ -118,6 +125,8 @@ void UnitData::unload()
     if (m_tu) {
         clang_disposeTranslationUnit(m_tu);
         m_tu = 0;
+        m_parsedUnsaved.clear();
+        m_isPrimed = false;
 
 #ifdef DEBUG_UNIT_COUNT
         qDebug() << "# translation units:" << (unitDataCount.fetchAndAddOrdered(-1) - 1);
@@ -127,7 +136,7 @@ void UnitData::unload()
 
 bool UnitData::isLoaded() const
 {
-    return m_tu && m_index;
+    return m_tu && !m_index.isNull();
 }
 
 void UnitData::updateTimeStamp()
@@ -194,6 +203,16 @@ void Unit::setUnsavedFiles(const UnsavedFiles &unsavedFiles)
     m_data->m_unsaved = unsavedFiles;
 }
 
+bool Unit::isParsedWith(const UnsavedFiles &unsavedFiles) const
+{
+    return isLoaded() && m_data->m_parsedUnsaved == unsavedFiles;
+}
+
+bool Unit::isPrimed() const
+{
+    return isLoaded() && m_data->m_isPrimed;
+}
+
 unsigned Unit::managementOptions() const
 {
     return m_data->m_managementOptions;
@@ -220,6 +239,11 @@ void Unit::makeUnique()
     m_data = QExplicitlySharedDataPointer<UnitData>(uniqueData);
 }
 
+QMutex *Unit::mutex() const
+{
+    return &m_data->m_mutex;
+}
+
 void Unit::parse()
 {
     m_data->unload();
@@ -227,13 +251,15 @@ void Unit::parse()
     m_data->updateTimeStamp();
 
     UnsavedFileData unsaved(m_data->m_unsaved);
-    m_data->m_tu = clang_parseTranslationUnit(m_data->m_index,
+    m_data->m_tu = clang_parseTranslationUnit(m_data->m_index.index(),
                                               m_data->m_fileName.constData(),
                                               m_data->m_sharedCompOptions.data(),
                                               m_data->m_sharedCompOptions.size(),
                                               unsaved.files(),
                                               unsaved.count(),
                                               m_data->m_managementOptions);
+    if (m_data->m_tu)
+        m_data->m_parsedUnsaved = m_data->m_unsaved;
 }
 
 void Unit::reparse()
@@ -242,8 +268,12 @@ void Unit::reparse()
 
     UnsavedFileData unsaved(m_data->m_unsaved);
     const unsigned opts = clang_defaultReparseOptions(m_data->m_tu);
-    if (clang_reparseTranslationUnit(m_data->m_tu, unsaved.count(), unsaved.files(), opts) != 0)
+    if (clang_reparseTranslationUnit(m_data->m_tu, unsaved.count(), unsaved.files(), opts) != 0) {
         m_data->unload();
+    } else {
+        m_data->m_parsedUnsaved = m_data->m_unsaved;
+        m_data->m_isPrimed = true;
+    }
 }
 
 void Unit::create()
@@ -291,12 +321,19 @@ CXSourceLocation Unit::getLocation(const CXFile &file, unsigned line, unsigned c
     return clang_getLocation(m_data->m_tu, file, line, column);
 }
 
-void Unit::codeCompleteAt(unsigned line, unsigned column, ScopedCXCodeCompleteResults &results)
+void Unit::codeCompleteAt(unsigned line, unsigned column, ScopedCXCodeCompleteResults &results,
+                          bool skipPreamble)
 {
     unsigned flags = clang_defaultCodeCompleteOptions();
 #if defined(CINDEX_VERSION) && (CINDEX_VERSION > 5)
     flags |= CXCodeComplete_IncludeBriefComments;
 #endif
+#if defined(CINDEX_VERSION) && (CINDEX_VERSION_MINOR >= 50)
+    if (skipPreamble)
+        flags |= CXCodeComplete_SkipPreamble;
+#else
+    Q_UNUSED(skipPreamble);
+#endif
 
     UnsavedFileData unsaved(m_data->m_unsaved);
     results.reset(clang_codeCompleteAt(m_data->m_tu, m_data->m_fileName.constData(),
@@ -304,6 +341,24 @@ void Unit::codeCompleteAt(unsigned line, unsigned column, ScopedCXCodeCompleteRe
                                        unsaved.files(), unsaved.count(), flags));
 }
 
+qint64 Unit::memoryUsage() const
+{
+    if (!isLoaded())
+        return 0;
+
+    qint64 bytes = 0;
+    CXTUResourceUsage usage = clang_getCXTUResourceUsage(m_data->m_tu);
+    for (unsigned i = 0; i < usage.numEntries; ++i) {
+        const CXTUResourceUsageEntry &entry = usage.entries[i];
+        if (entry.kind >= CXTUResourceUsage_MEMORY_IN_BYTES_BEGIN
+                && entry.kind <= CXTUResourceUsage_MEMORY_IN_BYTES_END) {
+            bytes += entry.amount;
+        }
+    }
+    clang_disposeCXTUResourceUsage(usage);
+    return bytes;
+}
+
 void Unit::tokenize(CXSourceRange range, CXToken **tokens, unsigned *tokenCount) const
 {
     Q_ASSERT(isLoaded());
@@ -348,7 +403,7 @@ CXIndex Unit::clangIndex() const
 {
     Q_ASSERT(isLoaded());
 
-    return m_data->m_index;
+    return m_data->m_index.index();
 }
 
 QString Unit::getTokenSpelling(const CXToken &tok) const
@@ -36,6 +36,7 @@
 
 #include <QExplicitlySharedDataPointer>
 #include <QMetaType>
+#include <QMutex>
 #include <QString>
 #include <QStringList>
 #include <QVarLengthArray>
@@ -60,7 +61,8 @@ class UnitData;
  * abstraction of the CXTranslationUnit.
  *
  * Notes:
- *  - This class is not thread-safe.
+ *  - This class is not thread-safe. Clients which share the TU between threads
+ *    must serialize access to it through mutex(), which is shared along with the data.
  *  - It's reponsibility of the client to make sure that the wrapped translation
  *    unit is consistent with the other data such as cursor and locations being used.
  *  - The data of the TU is shared.
@@ -93,6 +95,14 @@ public:
     UnsavedFiles unsavedFiles() const;
     void setUnsavedFiles(const UnsavedFiles &unsavedFiles);
 
+    // True if the unit is loaded and was last (re)parsed with exactly these unsaved files,
+    // so clients sharing the unit don't reparse it again for the same contents.
+    bool isParsedWith(const UnsavedFiles &unsavedFiles) const;
+
+    // True once the unit was reparsed after its initial parse: only then libclang has built
+    // the precompiled preamble and the cached completion results.
+    bool isPrimed() const;
+
     unsigned managementOptions() const;
     void setManagementOptions(unsigned managementOptions);
 
@@ -103,6 +113,8 @@ public:
     bool isUnique() const;
     void makeUnique();
 
+    QMutex *mutex() const;
+
     // Methods for generating the TU. Name mappings are direct, for example:
     //   - parse corresponds to clang_parseTranslationUnit
     //   - createFromSourceFile corresponds to clang_createTranslationUnitFromSourceFile
@@ -139,7 +151,13 @@ public:
     // - Physical source locations
     CXSourceLocation getLocation(const CXFile &file, unsigned line, unsigned column) const;
 
-    void codeCompleteAt(unsigned line, unsigned column, ScopedCXCodeCompleteResults &results);
+    // With skipPreamble, only declarations after the preamble are completed. Depends on
+    // libclang, see GlobalCompletionCache::isSupported().
+    void codeCompleteAt(unsigned line, unsigned column, ScopedCXCodeCompleteResults &results,
+                        bool skipPreamble = false);
+
+    // - Resource usage, the memory held by the TU in bytes (0 if not loaded)
+    qint64 memoryUsage() const;
 
     void tokenize(CXSourceRange range, CXToken **tokens, unsigned *tokenCount) const;
     void disposeTokens(CXToken *tokens, unsigned tokenCount) const;
@@ -34,28 +34,24 @@ using namespace ClangCodeModel::Internal;
 UnsavedFileData::UnsavedFileData(const UnsavedFiles &unsavedFiles)
     : m_count(unsavedFiles.count())
     , m_files(0)
+    , m_unsavedFiles(unsavedFiles)
 {
+    // The buffers are implicitly shared with the store, libclang reads them in place.
     if (m_count) {
         m_files = new CXUnsavedFile[m_count];
         unsigned idx = 0;
-        for (UnsavedFiles::const_iterator it = unsavedFiles.begin(); it != unsavedFiles.end(); ++it, ++idx) {
-            QByteArray contents = it.value();
-            const char *contentChars = qstrdup(contents.constData());
-            m_files[idx].Contents = contentChars;
-            m_files[idx].Length = contents.size();
+        for (UnsavedFiles::const_iterator it = m_unsavedFiles.constBegin();
+             it != m_unsavedFiles.constEnd(); ++it, ++idx) {
+            m_files[idx].Contents = it.value().constData();
+            m_files[idx].Length = it.value().size();
 
-            const char *fileName = qstrdup(it.key().toUtf8().constData());
-            m_files[idx].Filename = fileName;
+            m_fileNames.append(it.key().toUtf8());
+            m_files[idx].Filename = m_fileNames.last().constData();
         }
     }
 }
 
 UnsavedFileData::~UnsavedFileData()
 {
-    for (unsigned i = 0; i < m_count; ++i) {
-        delete[] m_files[i].Contents;
-        delete[] m_files[i].Filename;
-    }
-
     delete[] m_files;
 }
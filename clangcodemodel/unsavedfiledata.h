@@ -57,6 +57,8 @@ public:
 private:
     unsigned m_count;
     CXUnsavedFile *m_files;
+    UnsavedFiles m_unsavedFiles; // Owns the contents m_files points to.
+    QList<QByteArray> m_fileNames;
 };
 
 } // namespace Internal
@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#include "unsavedfilesstore.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QMutexLocker>
+
+using namespace ClangCodeModel;
+using namespace ClangCodeModel::Internal;
+using namespace CppTools;
+
+UnsavedFilesStore *UnsavedFilesStore::m_instance = 0;
+
+UnsavedFilesStore::UnsavedFilesStore()
+{
+    Q_ASSERT(!m_instance);
+    m_instance = this;
+}
+
+UnsavedFilesStore::~UnsavedFilesStore()
+{
+    m_instance = 0;
+}
+
+UnsavedFiles UnsavedFilesStore::update(const CppModelManagerInterface::WorkingCopy &workingCopy,
+                                       const QSet<QString> &modifiedFiles)
+{
+    QMutexLocker locker(&m_mutex);
+
+    bool changed = false;
+    QHash<QString, Buffer> buffers;
+    QHashIterator<QString, QPair<QByteArray, unsigned> > wcIter = workingCopy.iterator();
+    while (wcIter.hasNext()) {
+        wcIter.next();
+        const QString &fileName = wcIter.key();
+        if (!modifiedFiles.contains(fileName))
+            continue;
+
+        const unsigned revision = wcIter.value().second;
+        QHash<QString, Buffer>::const_iterator known = m_buffers.constFind(fileName);
+        if (known != m_buffers.constEnd() && known->m_revision == revision) {
+            buffers.insert(fileName, *known);
+            continue;
+        }
+
+        Buffer buffer;
+        buffer.m_revision = revision;
+        buffer.m_contents = wcIter.value().first;
+        buffer.m_exists = QFile::exists(fileName);
+        buffers.insert(fileName, buffer);
+        changed = true;
+    }
+
+    // Documents saved or closed since the last time.
+    if (buffers.size() != m_buffers.size())
+        changed = true;
+
+    m_buffers = buffers;
+    if (changed) {
+        m_current.clear();
+        QHash<QString, Buffer>::const_iterator it = m_buffers.constBegin();
+        for (; it != m_buffers.constEnd(); ++it) {
+            if (it->m_exists)
+                m_current.insert(it.key(), it->m_contents);
+        }
+    }
+
+    return m_current;
+}
@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of Qt Creator.
+**
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+****************************************************************************/
+
+#ifndef UNSAVEDFILESSTORE_H
+#define UNSAVEDFILESSTORE_H
+
+#include "utils.h"
+
+#include <cpptools/cppmodelmanagerinterface.h>
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+namespace ClangCodeModel {
+namespace Internal {
+
+/*
+ * The unsaved buffers handed to libclang, shared by completion, highlighting and indexing.
+ *
+ * Buffers are tracked by file and working copy revision, so a request only looks at the
+ * documents that changed since the previous one: the others keep their buffer (and the
+ * result of the check that the file exists on disk). When nothing changed at all, the
+ * previous set is returned as is, which makes it cheap to copy and to compare.
+ */
+class UnsavedFilesStore
+{
+    Q_DISABLE_COPY(UnsavedFilesStore)
+
+public:
+    UnsavedFilesStore();
+    ~UnsavedFilesStore();
+
+    static UnsavedFilesStore *instance()
+    { return m_instance; }
+
+    UnsavedFiles update(const CppTools::CppModelManagerInterface::WorkingCopy &workingCopy,
+                        const QSet<QString> &modifiedFiles);
+
+private:
+    struct Buffer
+    {
+        Buffer() : m_revision(0), m_exists(false) {}
+
+        unsigned m_revision;
+        QByteArray m_contents;
+        bool m_exists;
+    };
+
+    static UnsavedFilesStore *m_instance;
+
+    QMutex m_mutex;
+    QHash<QString, Buffer> m_buffers;
+    UnsavedFiles m_current;
+};
+
+} // Internal
+} // ClangCodeModel
+
+#endif // UNSAVEDFILESSTORE_H
@@ -34,6 +34,9 @@
 
 #include <clang-c/Index.h>
 
+#include <QCryptographicHash>
+#include <QDir>
+#include <QMap>
 #include <QMutex>
 #include <QMutexLocker>
 
@@ -65,6 +68,68 @@ QPair<bool, QStringList> precompile(const PCHInfo::Ptr &pchInfo)
 namespace {
 static bool clangInitialised = false;
 static QMutex initialisationMutex;
+
+// Options that take their value as the next argument
+static bool hasSeparateValue(const QString &option)
+{
+    return option == QLatin1String("-x")
+            || option == QLatin1String("-include")
+            || option == QLatin1String("-include-pch")
+            || option == QLatin1String("-imacros")
+            || option == QLatin1String("-isystem")
+            || option == QLatin1String("-iquote")
+            || option == QLatin1String("-idirafter")
+            || option == QLatin1String("-iframework")
+            || option == QLatin1String("-isysroot")
+            || option == QLatin1String("-target")
+            || option == QLatin1String("-arch")
+            || option == QLatin1String("-Xclang");
+}
+
+static bool isSearchPath(const QString &option)
+{
+    return option.startsWith(QLatin1String("-I"))
+            || option.startsWith(QLatin1String("-F"))
+            || option == QLatin1String("-isystem")
+            || option == QLatin1String("-iquote")
+            || option == QLatin1String("-idirafter")
+            || option == QLatin1String("-iframework");
+}
+
+static bool onlyAffectsDiagnostics(const QString &option)
+{
+    return option.startsWith(QLatin1String("-W"))
+            || option == QLatin1String("-w")
+            || option == QLatin1String("-pedantic")
+            || option == QLatin1String("-pedantic-errors")
+            || option.startsWith(QLatin1String("-fmessage-length"))
+            || option.startsWith(QLatin1String("-fdiagnostics-"))
+            || option.startsWith(QLatin1String("-ferror-limit"))
+            || option.startsWith(QLatin1String("-ftemplate-backtrace-limit"))
+            || option == QLatin1String("-fcolor-diagnostics")
+            || option == QLatin1String("-fno-color-diagnostics")
+            || option == QLatin1String("-fspell-checking")
+            || option == QLatin1String("-fno-spell-checking");
+}
+
+// Later occurrences of options with the same key override earlier ones
+static QString overrideKey(const QString &option)
+{
+    if (option.startsWith(QLatin1String("-D")) || option.startsWith(QLatin1String("-U"))) {
+        const QString macro = option.mid(2);
+        return QLatin1String("-D") + macro.left(macro.indexOf(QLatin1Char('=')));
+    }
+    if (option.startsWith(QLatin1String("-std=")))
+        return QLatin1String("-std=");
+    if (option.startsWith(QLatin1String("-fno-")))
+        return QLatin1String("-f") + option.mid(5);
+    if (option.startsWith(QLatin1String("-f"))) {
+        const int eq = option.indexOf(QLatin1Char('='));
+        return eq == -1 ? option : option.left(eq);
+    }
+    return option;
+}
+
 } // anonymous namespace
 
 void initializeClang()
@@ -84,6 +149,50 @@ void initializeClang()
     qRegisterMetaType<QList<ClangCodeModel::Diagnostic> >();
 }
 
+QStringList normalizedOptions(const QStringList &options)
+{
+    QStringList language;
+    QMap<QString, QString> flags; // sorted by key, last one wins
+    QStringList ordered;
+
+    for (int i = 0, ei = options.size(); i < ei; ++i) {
+        const QString &option = options.at(i);
+        if (option.isEmpty() || onlyAffectsDiagnostics(option))
+            continue;
+
+        if (hasSeparateValue(option) && i + 1 < ei) {
+            QString value = options.at(++i);
+            if (option == QLatin1String("-x")) {
+                language = QStringList() << option << value;
+                continue;
+            }
+            if (isSearchPath(option))
+                value = QDir::cleanPath(value);
+            const QString joined = option + QLatin1Char(' ') + value;
+            if (!ordered.contains(joined))
+                ordered << joined;
+        } else if (isSearchPath(option)) {
+            // -I and -F with the path attached
+            const QString joined = option.left(2) + QDir::cleanPath(option.mid(2));
+            if (!ordered.contains(joined))
+                ordered << joined;
+        } else {
+            flags.insert(overrideKey(option), option);
+        }
+    }
+
+    QStringList result = language;
+    result += flags.values();
+    result += ordered;
+    return result;
+}
+
+QByteArray optionsFingerprint(const QStringList &options)
+{
+    return QCryptographicHash::hash(normalizedOptions(options).join(QLatin1String("\n")).toUtf8(),
+                                    QCryptographicHash::Sha1);
+}
+
 } // Internal namespace
 } // ClangCodeModel namespace
 
@@ -59,6 +59,19 @@ QPair<bool, QStringList> precompile(const PCHInfo::Ptr &pchInfo);
 
 void initializeClang();
 
+/**
+ * Brings compilation options into a canonical form: duplicates are dropped, macros
+ * are sorted, and options that only affect diagnostics are left out. Options whose
+ * order matters, like search paths and forced includes, keep their order.
+ */
+QStringList normalizedOptions(const QStringList &options);
+
+/**
+ * A hash of normalizedOptions(). Option lists with the same fingerprint produce the
+ * same translation unit.
+ */
+QByteArray optionsFingerprint(const QStringList &options);
+
 } // Internal namespace
 } // ClangCodeModel namespace
 